@@ -13,6 +13,7 @@
 #include "snac.h"
 
 #include <sys/wait.h>
+#include <pthread.h>
 
 const char *public_address = "https:/" "/www.w3.org/ns/activitystreams#Public";
 
@@ -294,7 +295,7 @@ int send_to_inbox_raw(const char *keyid, const char *seckey,
 {
     int status;
     xs_dict *response;
-    xs *j_msg = xs_json_dumps_pp((xs_dict *)msg, 4);
+    xs *j_msg = xs_json_dumps((xs_dict *)msg);
 
     response = http_signed_request_raw(keyid, seckey, "POST", inbox,
         NULL, j_msg, strlen(j_msg), &status, payload, p_size, timeout);
@@ -1927,11 +1928,88 @@ int process_queue(void)
 
 /** HTTP handlers */
 
+/** serialized response cache **/
+
+/* final JSON bodies of the most requested objects (actors, outboxes
+   and posts), indexed by their etag; as the etag changes whenever any
+   of the files the response is built from changes, there is no need
+   for explicit invalidation */
+
+static pthread_mutex_t ap_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xs_dict *ap_cache = NULL;
+static int ap_cache_entries = 0;
+
+#ifndef AP_CACHE_MAX_ENTRIES
+#define AP_CACHE_MAX_ENTRIES 256
+#endif
+
+#ifndef AP_CACHE_MAX_SIZE
+#define AP_CACHE_MAX_SIZE 262144
+#endif
+
+static xs_str *_ap_cache_get(const char *etag)
+/* returns a copy of a cached body, or NULL */
+{
+    xs_str *body = NULL;
+
+    pthread_mutex_lock(&ap_cache_mutex);
+
+    if (ap_cache != NULL) {
+        const char *v = xs_dict_get(ap_cache, etag);
+
+        if (v != NULL)
+            body = xs_dup(v);
+    }
+
+    pthread_mutex_unlock(&ap_cache_mutex);
+
+    return body;
+}
+
+
+static void _ap_cache_put(const char *etag, const char *body)
+/* stores a body in the cache */
+{
+    if (xs_is_null(etag) || strlen(body) > AP_CACHE_MAX_SIZE)
+        return;
+
+    pthread_mutex_lock(&ap_cache_mutex);
+
+    /* too many entries? start again (stale ones are never hit) */
+    if (ap_cache == NULL || ap_cache_entries >= AP_CACHE_MAX_ENTRIES) {
+        xs_free(ap_cache);
+        ap_cache = xs_arena_promote(xs_dict_new());
+        ap_cache_entries = 0;
+    }
+
+    if (xs_dict_get(ap_cache, etag) == NULL) {
+        ap_cache = xs_dict_append(ap_cache, etag, body);
+        ap_cache_entries++;
+    }
+
+    pthread_mutex_unlock(&ap_cache_mutex);
+}
+
+
+static int _ap_cache_check(const char *inm, const char *etag, xs_str **body)
+/* checks if a response can be served from the client or the cache */
+{
+    if (etag_match(inm, etag))
+        return 304;
+
+    if (!xs_is_null(etag) && (*body = _ap_cache_get(etag)) != NULL)
+        return 200;
+
+    return 0;
+}
+
+
 int activitypub_get_handler(const xs_dict *req, const char *q_path,
-                            char **body, int *b_size, char **ctype)
+                            char **body, int *b_size, char **ctype, xs_str **etag)
 {
     int status = 200;
     char *accept = xs_dict_get(req, "accept");
+    const char *inm = xs_dict_get(req, "if-none-match");
     snac snac;
     xs *msg = NULL;
 
@@ -1958,40 +2036,56 @@ int activitypub_get_handler(const xs_dict *req, const char *q_path,
 
     if (p_path == NULL) {
         /* if there was no component after the user, it's an actor request */
-        msg = msg_actor(&snac);
+        const char *files[] = { "user.json", "user_o.json", "key.json", NULL };
+        char *ua = xs_dict_get(req, "user-agent");
+
         *ctype = "application/ld+json; profile=\"https://www.w3.org/ns/activitystreams\"";
+        *etag  = etag_build(&snac, "actor", files, NULL);
 
-        char *ua = xs_dict_get(req, "user-agent");
+        if ((status = _ap_cache_check(inm, *etag, body)) == 0) {
+            msg    = msg_actor(&snac);
+            status = 200;
+        }
 
-        snac_debug(&snac, 0, xs_fmt("serving actor [%s]", ua ? ua : "No UA"));
+        snac_debug(&snac, status == 304 ? 1 : 0,
+            xs_fmt("serving actor %d [%s]", status, ua ? ua : "No UA"));
     }
     else
     if (strcmp(p_path, "outbox") == 0) {
-        xs *id = xs_fmt("%s/outbox", snac.actor);
+        const char *files[] = { "public.idx", "user.json", "user_o.json", NULL };
         xs *elems = timeline_simple_list(&snac, "public", 0, 20);
-        xs *list = xs_list_new();
-        msg = msg_collection(&snac, id);
-        char *p, *v;
 
-        p = elems;
-        while (xs_list_iter(&p, &v)) {
-            xs *i = NULL;
+        /* the posts can be edited without touching the index */
+        *etag = etag_build_list(&snac, "outbox", files, elems);
 
-            if (valid_status(object_get_by_md5(v, &i))) {
-                char *type = xs_dict_get(i, "type");
-                char *id   = xs_dict_get(i, "id");
+        if ((status = _ap_cache_check(inm, *etag, body)) == 0) {
+            xs *id = xs_fmt("%s/outbox", snac.actor);
+            xs *list = xs_list_new();
+            msg = msg_collection(&snac, id);
+            char *p, *v;
 
-                if (type && id && strcmp(type, "Note") == 0 && xs_startswith(id, snac.actor)) {
-                    i = xs_dict_del(i, "_snac");
-                    list = xs_list_append(list, i);
+            p = elems;
+            while (xs_list_iter(&p, &v)) {
+                xs *i = NULL;
+
+                if (valid_status(object_get_by_md5(v, &i))) {
+                    char *type = xs_dict_get(i, "type");
+                    char *id   = xs_dict_get(i, "id");
+
+                    if (type && id && strcmp(type, "Note") == 0 && xs_startswith(id, snac.actor)) {
+                        i = xs_dict_del(i, "_snac");
+                        list = xs_list_append(list, i);
+                    }
                 }
             }
-        }
 
-        /* replace the 'orderedItems' with the latest posts */
-        xs *items = xs_number_new(xs_list_len(list));
-        msg = xs_dict_set(msg, "orderedItems", list);
-        msg = xs_dict_set(msg, "totalItems",   items);
+            /* replace the 'orderedItems' with the latest posts */
+            xs *items = xs_number_new(xs_list_len(list));
+            msg = xs_dict_set(msg, "orderedItems", list);
+            msg = xs_dict_set(msg, "totalItems",   items);
+
+            status = 200;
+        }
     }
     else
     if (strcmp(p_path, "followers") == 0 || strcmp(p_path, "following") == 0) {
@@ -2002,16 +2096,23 @@ int activitypub_get_handler(const xs_dict *req, const char *q_path,
     if (xs_startswith(p_path, "p/")) {
         xs *id = xs_fmt("%s/%s", snac.actor, p_path);
 
-        status = object_get(id, &msg);
+        if (object_here(id))
+            *etag = etag_build(NULL, "object", NULL, id);
+
+        if ((status = _ap_cache_check(inm, *etag, body)) == 0)
+            status = object_get(id, &msg);
     }
     else
         status = 404;
 
     if (status == 200 && msg != NULL) {
-        *body   = xs_json_dumps_pp(msg, 4);
-        *b_size = strlen(*body);
+        *body = xs_json_dumps_pp(msg, 4);
+        _ap_cache_put(*etag, *body);
     }
 
+    if (status == 200 && *body != NULL)
+        *b_size = strlen(*body);
+
     snac_debug(&snac, 1, xs_fmt("activitypub_get_handler serving %s %d", q_path, status));
 
     user_free(&snac);
@@ -2042,6 +2143,17 @@ int activitypub_post_handler(const xs_dict *req, const char *q_path,
         xs_str_in(i_ctype, "application/ld+json") == -1)
         return 0;
 
+    /* reject blocked instances before parsing the payload,
+       by the signer (the keyId is an url on its instance) */
+    if (!xs_is_null(v = xs_dict_get(req, "signature")) &&
+        (v = strstr(v, "keyId=\"")) != NULL && is_instance_blocked(v + 7)) {
+        srv_debug(1, xs_fmt("full instance block for signer %s", v + 7));
+
+        *body  = xs_str_new("blocked");
+        *ctype = "text/plain";
+        return 403;
+    }
+
     /* decode the message */
     xs *msg = xs_json_loads(payload);
     const char *id;
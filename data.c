@@ -18,7 +18,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 
-double disk_layout = 2.7;
+double disk_layout = 2.9;
 
 /* storage serializer */
 pthread_mutex_t data_mutex = {0};
@@ -98,9 +98,6 @@ int srv_open(char *basedir, int auto_upgrade)
     xs *qdir = xs_fmt("%s/queue", srv_basedir);
     mkdirx(qdir);
 
-    xs *ibdir = xs_fmt("%s/inbox", srv_basedir);
-    mkdirx(ibdir);
-
 #ifdef __OpenBSD__
     char *v = xs_dict_get(srv_config, "disable_openbsd_security");
 
@@ -128,6 +125,8 @@ int srv_open(char *basedir, int auto_upgrade)
 
 void srv_free(void)
 {
+    inbox_flush(0);
+
     xs_free(srv_basedir);
     xs_free(srv_config);
     xs_free(srv_baseurl);
@@ -149,6 +148,129 @@ void user_free(snac *snac)
 }
 
 
+/* the parsed configuration and keys of each user are cached, to avoid
+   reading and parsing them every time a user is opened; they are
+   revalidated by the status of their files and handed out as copies,
+   as the callers are free to modify (and always free) them */
+
+typedef struct {
+    char *uid;
+    struct stat st[3];      /* user.json, key.json and user_o.json */
+    xs_dict *config;
+    xs_dict *config_o;      /* NULL if there is no user_o.json */
+    xs_dict *key;
+    xs_str *md5;
+} user_cache_entry;
+
+static pthread_mutex_t user_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static user_cache_entry *user_cache = NULL;
+static int user_cache_n = 0;
+
+static const char *_user_files[] = { "user.json", "key.json", "user_o.json" };
+
+
+static void _user_stat(snac *snac, struct stat st[3])
+/* gets the status of the user files */
+{
+    int n;
+
+    for (n = 0; n < 3; n++) {
+        xs *fn = xs_fmt("%s/%s", snac->basedir, _user_files[n]);
+
+        if (stat(fn, &st[n]) == -1)
+            memset(&st[n], '\0', sizeof(struct stat));
+    }
+}
+
+
+static int _user_stat_eq(const struct stat *a, const struct stat *b)
+/* checks if a file has not changed */
+{
+    return a->st_ino == b->st_ino && a->st_size == b->st_size &&
+        a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+
+static user_cache_entry *_user_cache_find(const char *uid)
+/* finds the cache entry for a user (user_cache_mutex must be locked) */
+{
+    int n;
+
+    for (n = 0; n < user_cache_n; n++) {
+        if (strcmp(user_cache[n].uid, uid) == 0)
+            return &user_cache[n];
+    }
+
+    return NULL;
+}
+
+
+static int _user_cache_get(snac *snac, struct stat st[3])
+/* fills the user from the cache, if it's still valid */
+{
+    user_cache_entry *e;
+    int ret = 0;
+
+    pthread_mutex_lock(&user_cache_mutex);
+
+    if ((e = _user_cache_find(snac->uid)) != NULL &&
+        _user_stat_eq(&e->st[0], &st[0]) &&
+        _user_stat_eq(&e->st[1], &st[1]) &&
+        _user_stat_eq(&e->st[2], &st[2])) {
+        snac->config   = xs_dup(e->config);
+        snac->key      = xs_dup(e->key);
+        snac->config_o = e->config_o ? xs_dup(e->config_o) : xs_dict_new();
+        snac->md5      = xs_dup(e->md5);
+        ret = 1;
+    }
+
+    pthread_mutex_unlock(&user_cache_mutex);
+
+    return ret;
+}
+
+
+static void _user_cache_put(snac *snac, struct stat st[3])
+/* stores a just opened user in the cache */
+{
+    time_t t = time(NULL);
+    user_cache_entry *e;
+    int n;
+
+    /* files modified right now could change again within
+       the timestamp resolution, so don't trust them yet */
+    for (n = 0; n < 3; n++) {
+        if (st[n].st_mtim.tv_sec >= t - 1)
+            return;
+    }
+
+    pthread_mutex_lock(&user_cache_mutex);
+
+    if ((e = _user_cache_find(snac->uid)) == NULL) {
+        user_cache = realloc(user_cache, (user_cache_n + 1) * sizeof(user_cache_entry));
+        e = &user_cache[user_cache_n++];
+
+        e->uid = strdup(snac->uid);
+    }
+    else {
+        xs_free(e->config);
+        xs_free(e->config_o);
+        xs_free(e->key);
+        xs_free(e->md5);
+    }
+
+    memcpy(e->st, st, sizeof(e->st));
+
+    /* these outlive the request */
+    e->config   = xs_arena_promote(xs_dup(snac->config));
+    e->key      = xs_arena_promote(xs_dup(snac->key));
+    e->config_o = st[2].st_ino ? xs_arena_promote(xs_dup(snac->config_o)) : NULL;
+    e->md5      = xs_arena_promote(xs_dup(snac->md5));
+
+    pthread_mutex_unlock(&user_cache_mutex);
+}
+
+
 int user_open(snac *snac, const char *uid)
 /* opens a user */
 {
@@ -158,14 +280,24 @@ int user_open(snac *snac, const char *uid)
 
     if (validate_uid(uid)) {
         xs *cfg_file;
+        struct stat st[3];
         FILE *f;
 
         snac->uid = xs_str_new(uid);
 
         snac->basedir = xs_fmt("%s/user/%s", srv_basedir, uid);
 
+        /* get the status before reading, so that the cache never
+           stores the old content of a changed file as current */
+        _user_stat(snac, st);
+
         cfg_file = xs_fmt("%s/user.json", snac->basedir);
 
+        if (_user_cache_get(snac, st)) {
+            snac->actor = xs_fmt("%s/%s", srv_baseurl, uid);
+            ret = 1;
+        }
+        else
         if ((f = fopen(cfg_file, "r")) != NULL) {
             xs *cfg_data;
 
@@ -201,6 +333,8 @@ int user_open(snac *snac, const char *uid)
 
                         if (snac->config_o == NULL)
                             snac->config_o = xs_dict_new();
+
+                        _user_cache_put(snac, st);
                     }
                     else
                         srv_log(xs_fmt("error parsing '%s'", key_file));
@@ -232,23 +366,222 @@ xs_list *user_list(void)
 }
 
 
-int user_open_by_md5(snac *snac, const char *md5)
-/* iterates all users searching by md5 */
+/** user directory **/
+
+/* the directory of users (uid, actor, md5, name and last login) is kept
+   in memory, so that users can be found by actor or md5 and listed
+   without opening all of them; it's rebuilt when the user directory
+   or the configuration of a user change, while the last logins are
+   updated by lastlog_write() itself */
+
+#ifndef USER_DIR_CHECK_SECS
+#define USER_DIR_CHECK_SECS 1
+#endif
+
+static pthread_mutex_t user_dir_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xs_list *user_dir = NULL;        /* list of entries */
+static xs_dict *user_dir_keys = NULL;   /* actor or md5: uid */
+static xs_dict_idx user_dir_idx;
+static xs_str *user_dir_stamp = NULL;   /* status of the user directory */
+static time_t user_dir_checked = 0;
+static time_t user_dir_e_checked = 0;
+
+
+static xs_str *_user_dir_stamp(const char *fn)
+/* returns a string with the status of a file (empty if too recent to be trusted) */
 {
-    xs *ulist  = user_list();
-    xs_list *p = ulist;
-    xs_str *v;
+    struct stat st;
 
-    while (xs_list_iter(&p, &v)) {
-        user_open(snac, v);
+    if (stat(fn, &st) == -1)
+        return xs_str_new("-");
 
-        if (strcmp(snac->md5, md5) == 0)
-            return 1;
+    /* it may change again within the timestamp resolution */
+    if (st.st_mtim.tv_sec >= time(NULL) - 1)
+        return xs_str_new("");
 
-        user_free(snac);
+    return xs_fmt("%ld:%ld.%09ld", (long)st.st_ino,
+                  (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+}
+
+
+static xs_str *_user_entry_stamp(const char *uid)
+/* returns the status of the configuration a directory entry comes from */
+{
+    xs *c_fn = xs_fmt("%s/user/%s/user.json", srv_basedir, uid);
+
+    return _user_dir_stamp(c_fn);
+}
+
+
+static void _user_dir_load(void)
+/* (re)builds the user directory (user_dir_mutex must be locked) */
+{
+    xs *u_dir   = xs_fmt("%s/user", srv_basedir);
+    xs *stamp   = _user_dir_stamp(u_dir);
+    xs *list    = user_list();
+    xs_list *dir = xs_list_new();
+    xs_dict *keys = xs_dict_new();
+    xs_list *p  = list;
+    xs_str *uid;
+
+    while (xs_list_iter(&p, &uid)) {
+        xs *e_stamp = _user_entry_stamp(uid);
+        snac snac;
+
+        if (user_open(&snac, uid)) {
+            xs *e  = xs_dict_new();
+            xs *ll = xs_number_new(lastlog_get(&snac));
+            const char *name = xs_dict_get(snac.config, "name");
+
+            e = xs_dict_append(e, "uid",     snac.uid);
+            e = xs_dict_append(e, "actor",   snac.actor);
+            e = xs_dict_append(e, "md5",     snac.md5);
+            if (xs_type(name) == XSTYPE_STRING)
+                e = xs_dict_append(e, "name", name);
+            e = xs_dict_append(e, "lastlog", ll);
+            e = xs_dict_append(e, "stamp",   e_stamp);
+
+            dir  = xs_list_append(dir, e);
+            keys = xs_dict_append(keys, snac.actor, snac.uid);
+            keys = xs_dict_append(keys, snac.md5, snac.uid);
+
+            user_free(&snac);
+        }
     }
 
-    return 0;
+    if (user_dir != NULL) {
+        xs_dict_idx_free(&user_dir_idx);
+        xs_free(user_dir);
+        xs_free(user_dir_keys);
+        xs_free(user_dir_stamp);
+    }
+
+    /* these outlive the request */
+    user_dir       = xs_arena_promote(dir);
+    user_dir_keys  = xs_arena_promote(keys);
+    user_dir_stamp = xs_arena_promote(xs_dup(stamp));
+
+    xs_dict_idx_init(&user_dir_idx, user_dir_keys);
+    user_dir_idx.hash = xs_arena_promote(user_dir_idx.hash);
+
+    srv_debug(1, xs_fmt("user directory loaded (%d users)", xs_list_len(user_dir)));
+}
+
+
+static void _user_dir_check(int entries)
+/* rebuilds the user directory if it's outdated (user_dir_mutex must be locked);
+   the entries themselves are only checked if asked to; both checks
+   are done at most once every USER_DIR_CHECK_SECS */
+{
+    time_t t = time(NULL);
+
+    if (user_dir != NULL && t - user_dir_checked < USER_DIR_CHECK_SECS &&
+        (!entries || t - user_dir_e_checked < USER_DIR_CHECK_SECS))
+        return;
+
+    user_dir_checked = t;
+
+    if (entries)
+        user_dir_e_checked = t;
+
+    xs *u_dir = xs_fmt("%s/user", srv_basedir);
+    xs *stamp = _user_dir_stamp(u_dir);
+    int ok    = user_dir != NULL && *stamp && strcmp(stamp, user_dir_stamp) == 0;
+
+    if (ok && entries) {
+        xs_list *p = user_dir;
+        xs_dict *e;
+
+        while (ok && xs_list_iter(&p, &e)) {
+            xs *e_stamp = _user_entry_stamp(xs_dict_get(e, "uid"));
+            const char *o_stamp = xs_dict_get(e, "stamp");
+
+            ok = *e_stamp && strcmp(e_stamp, o_stamp) == 0;
+        }
+    }
+
+    if (!ok)
+        _user_dir_load();
+}
+
+
+xs_list *user_directory(void)
+/* returns the directory of users, as a list of
+   dicts with uid, actor, md5, name and lastlog */
+{
+    xs_list *l;
+
+    pthread_mutex_lock(&user_dir_mutex);
+
+    _user_dir_check(1);
+    l = xs_dup(user_dir);
+
+    pthread_mutex_unlock(&user_dir_mutex);
+
+    return l;
+}
+
+
+xs_str *user_find(const char *id)
+/* returns the uid of the user with this actor or md5, or NULL */
+{
+    xs_str *uid = NULL;
+    const char *v;
+
+    pthread_mutex_lock(&user_dir_mutex);
+
+    _user_dir_check(0);
+
+    if ((v = xs_dict_idx_get(&user_dir_idx, id)) != NULL)
+        uid = xs_dup(v);
+
+    pthread_mutex_unlock(&user_dir_mutex);
+
+    return uid;
+}
+
+
+static void _user_dir_lastlog(const char *uid, double t)
+/* updates the last login of a user in the directory */
+{
+    pthread_mutex_lock(&user_dir_mutex);
+
+    if (user_dir != NULL) {
+        xs_list *dir = xs_list_new();
+        xs *ll       = xs_number_new(t);
+        xs_list *p   = user_dir;
+        xs_dict *e;
+
+        while (xs_list_iter(&p, &e)) {
+            if (strcmp(xs_dict_get(e, "uid"), uid) == 0) {
+                xs *ne = xs_dup(e);
+                ne  = xs_dict_set(ne, "lastlog", ll);
+                dir = xs_list_append(dir, ne);
+            }
+            else
+                dir = xs_list_append(dir, e);
+        }
+
+        /* it outlives the request */
+        xs_free(user_dir);
+        user_dir = xs_arena_promote(dir);
+    }
+
+    pthread_mutex_unlock(&user_dir_mutex);
+}
+
+
+int user_open_by_md5(snac *snac, const char *md5)
+/* opens a user by its md5 */
+{
+    xs *uid = user_find(md5);
+
+    if (uid == NULL) {
+        memset(snac, '\0', sizeof(struct _snac));
+        return 0;
+    }
+
+    return user_open(snac, uid);
 }
 
 
@@ -365,6 +698,51 @@ int index_del_md5(const char *fn, const char *md5)
 }
 
 
+int index_del_md5_list(const char *fn, const xs_list *md5s)
+/* deletes every appearance of a list of md5s from an index, in one pass */
+{
+    int n = 0;
+    xs_set set;
+    xs_list *p;
+    xs_str *v;
+    FILE *f;
+
+    xs_set_init(&set);
+
+    p = (xs_list *)md5s;
+    while (xs_list_iter(&p, &v))
+        xs_set_add(&set, v);
+
+    pthread_mutex_lock(&data_mutex);
+
+    if ((f = fopen(fn, "r+")) != NULL) {
+        char line[256];
+
+        while (fgets(line, sizeof(line), f) != NULL) {
+            line[32] = '\0';
+
+            if (xs_set_in(&set, line)) {
+                /* same as index_del_md5(), but go on reading */
+                fseek(f, -33, SEEK_CUR);
+                fwrite("-", 1, 1, f);
+                fseek(f, 32, SEEK_CUR);
+                n++;
+            }
+        }
+
+        fclose(f);
+    }
+    else
+        n = -1;
+
+    pthread_mutex_unlock(&data_mutex);
+
+    xs_set_free(&set);
+
+    return n;
+}
+
+
 int index_del(const char *fn, const char *id)
 /* deletes an id from an index */
 {
@@ -643,9 +1021,7 @@ int _object_add(const char *id, const xs_dict *obj, int ow)
     if ((f = fopen(fn, "w")) != NULL) {
         flock(fileno(f), LOCK_EX);
 
-        xs *j = xs_json_dumps_pp(obj, 4);
-
-        fwrite(j, strlen(j), 1, f);
+        xs_json_dump(obj, 4, f);
         fclose(f);
 
         /* does this object has a parent? */
@@ -671,6 +1047,12 @@ int _object_add(const char *id, const xs_dict *obj, int ow)
                 index_add(p_idx, in_reply_to);
                 srv_debug(1, xs_fmt("object_add added parent %s to %s", in_reply_to, p_idx));
             }
+
+            /* add it to the conversation */
+            xs *p_md5 = xs_md5_hex(in_reply_to, strlen(in_reply_to));
+            xs *md5   = xs_md5_hex(id, strlen(id));
+
+            object_thread_add(p_md5, md5);
         }
     }
     else {
@@ -715,6 +1097,10 @@ int object_del_by_md5(const char *md5)
 
         p = files;
         while (xs_list_iter(&p, &v)) {
+            /* the conversation outlives its root; purge_server() drops it */
+            if (xs_endswith(v, "_t.idx"))
+                continue;
+
             srv_debug(1, xs_fmt("object_del index %s", v));
             unlink(v);
         }
@@ -818,85 +1204,386 @@ int object_parent(const char *md5, char *buf, int size)
 }
 
 
-int object_admire(const char *id, const char *actor, int like)
-/* actor likes or announces this object */
+/** conversations **/
+
+/* the root of a conversation keeps all its replies in _t.idx, one
+   "md5 depth" line each, in the order a thread is shown (every entry
+   is followed by its own replies); every reply keeps its root in _r.idx */
+
+static xs_dict *_object_thread_read(xs_dict *thread, const char *fn)
+/* reads a conversation index into a dict of md5 -> depth */
 {
-    int status = 200;
-    xs *fn     = _object_fn(id);
+    FILE *f;
 
-    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+    if ((f = fopen(fn, "r")) != NULL) {
+        char line[256];
 
-    if (!index_in(fn, actor)) {
-        status = index_add(fn, actor);
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (strlen(line) < 34)
+                continue;
 
-        srv_debug(1, xs_fmt("object_admire (%s) %s %s", like ? "Like" : "Announce", actor, fn));
+            line[32] = '\0';
+
+            xs *d = xs_number_new(atoi(line + 33));
+            thread = xs_dict_append(thread, line, d);
+        }
+
+        fclose(f);
     }
 
-    return status;
+    return thread;
 }
 
 
-int object_unadmire(const char *id, const char *actor, int like)
-/* actor no longer likes or announces this object */
+static int _object_thread_alive(const char *fn)
+/* checks if any reply in a conversation index is still here
+   (so that it can be kept after its root is gone) */
 {
-    int status;
-    xs *fn = _object_fn(id);
-
-    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+    int ret = 0;
 
-    status = index_del(fn, actor);
+    if (xs_endswith(fn, "_t.idx")) {
+        xs *thread = _object_thread_read(xs_dict_new(), fn);
+        xs_dict *p = thread;
+        xs_str *k;
+        xs_val *v;
 
-    srv_debug(0,
-        xs_fmt("object_unadmire (%s) %s %s %d", like ? "Like" : "Announce", actor, fn, status));
+        while (!ret && xs_dict_iter(&p, &k, &v))
+            ret = object_here_by_md5(k);
+    }
 
-    return status;
+    return ret;
 }
 
 
-int _object_user_cache(snac *snac, const char *id, const char *cachedir, int del)
-/* adds or deletes from a user cache */
+static int _object_thread_write(const char *fn, const xs_dict *thread)
+/* writes a conversation index */
 {
-    xs *ofn = _object_fn(id);
-    xs *l   = xs_split(ofn, "/");
-    xs *cfn = xs_fmt("%s/%s/%s", snac->basedir, cachedir, xs_list_get(l, -1));
-    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, cachedir);
-    int ret;
+    xs *nfn = xs_fmt("%s.new", fn);
+    int status = 500;
+    FILE *f;
 
-    if (del) {
-        ret = unlink(cfn);
-        index_del(idx, id);
-    }
-    else {
-        if ((ret = link(ofn, cfn)) != -1)
-            index_add(idx, id);
+    if ((f = fopen(nfn, "w")) != NULL) {
+        xs_dict *p = (xs_dict *)thread;
+        xs_str *k;
+        xs_val *v;
+
+        while (xs_dict_iter(&p, &k, &v))
+            fprintf(f, "%s %d\n", k, (int)xs_number_get(v));
+
+        fclose(f);
+        rename(nfn, fn);
+
+        status = 200;
     }
 
-    return ret;
+    return status;
 }
 
 
-int object_user_cache_add(snac *snac, const char *id, const char *cachedir)
-/* caches an object into a user cache */
+static void _object_root_write(const char *md5, const char *root)
+/* (re)writes the one-element index with the root of a reply */
 {
-    return _object_user_cache(snac, id, cachedir, 0);
-}
+    xs *fn = _object_fn_by_md5(md5, "_object_root_write");
+    FILE *f;
 
+    fn = xs_replace_i(fn, ".json", "_r.idx");
 
-int object_user_cache_del(snac *snac, const char *id, const char *cachedir)
-/* deletes an object from a user cache */
-{
-    return _object_user_cache(snac, id, cachedir, 1);
+    if ((f = fopen(fn, "w")) != NULL) {
+        fprintf(f, "%s\n", root);
+        fclose(f);
+    }
 }
 
 
-int object_user_cache_in(snac *snac, const char *id, const char *cachedir)
-/* checks if an object is stored in a cache */
+static xs_dict *_object_thread_insert(xs_dict *thread, const char *root,
+                                      const char *md5, int depth)
+/* appends md5 and the replies it may already have to a conversation */
 {
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    xs *cfn = xs_fmt("%s/%s/%s.json", snac->basedir, cachedir, md5);
+    xs *d = xs_number_new(depth);
+    thread = xs_dict_append(thread, md5, d);
 
-    return !!(mtime(cfn) != 0.0);
-}
+    _object_root_write(md5, root);
+
+    /* was it the root of its own conversation, waiting for its parent? */
+    xs *fn = _object_fn_by_md5(md5, "_object_thread_insert");
+    fn = xs_replace_i(fn, ".json", "_t.idx");
+
+    if (mtime(fn) > 0.0) {
+        xs *sub = _object_thread_read(xs_dict_new(), fn);
+        xs_dict *p = sub;
+        xs_str *k;
+        xs_val *v;
+
+        /* move it into this one, one level below */
+        while (xs_dict_iter(&p, &k, &v)) {
+            xs *sd = xs_number_new(depth + (int)xs_number_get(v));
+            thread = xs_dict_append(thread, k, sd);
+
+            _object_root_write(k, root);
+        }
+
+        unlink(fn);
+    }
+
+    return thread;
+}
+
+
+int object_thread_add(const char *p_md5, const char *md5)
+/* adds a reply to the conversation of its parent */
+{
+    int status = 204; /* No content */
+    xs *r_idx = _object_fn_by_md5(md5, "object_thread_add");
+    char root[256];
+
+    r_idx = xs_replace_i(r_idx, ".json", "_r.idx");
+
+    pthread_mutex_lock(&data_mutex);
+
+    /* the root is the parent's, or the parent itself */
+    if (!object_root(p_md5, root, sizeof(root)))
+        snprintf(root, sizeof(root), "%s", p_md5);
+
+    /* not already in a conversation (checked under the lock, so that two
+       threads adding the same reply don't both add it) and not a loop */
+    if (mtime(r_idx) == 0.0 && strcmp(root, md5) != 0 && strcmp(p_md5, md5) != 0) {
+        xs *t_idx = _object_fn_by_md5(root, "object_thread_add");
+        t_idx = xs_replace_i(t_idx, ".json", "_t.idx");
+
+        xs *thread = _object_thread_read(xs_dict_new(), t_idx);
+        xs *nt     = xs_dict_new();
+        xs_dict *p = thread;
+        xs_str *k;
+        xs_val *v;
+        int in_parent = strcmp(root, p_md5) == 0;
+        int p_depth   = 0;
+        int done      = 0;
+
+        /* insert it after the last reply to its parent */
+        while (xs_dict_iter(&p, &k, &v)) {
+            int depth = (int)xs_number_get(v);
+
+            if (in_parent && !done && depth <= p_depth) {
+                nt   = _object_thread_insert(nt, root, md5, p_depth + 1);
+                done = 1;
+            }
+
+            nt = xs_dict_append(nt, k, v);
+
+            if (strcmp(k, p_md5) == 0) {
+                in_parent = 1;
+                p_depth   = depth;
+            }
+        }
+
+        if (!done)
+            nt = _object_thread_insert(nt, root, md5, p_depth + 1);
+
+        status = _object_thread_write(t_idx, nt);
+
+        srv_debug(1, xs_fmt("object_thread_add %s to %s (root %s)", md5, p_md5, root));
+    }
+
+    pthread_mutex_unlock(&data_mutex);
+
+    return status;
+}
+
+
+int object_root(const char *md5, char *buf, int size)
+/* returns the root of the conversation of a reply, if any */
+{
+    xs *fn = _object_fn_by_md5(md5, "object_root");
+
+    fn = xs_replace_i(fn, ".json", "_r.idx");
+    return index_first(fn, buf, size);
+}
+
+
+xs_dict *object_thread(const char *md5)
+/* returns the full conversation of an object as md5 -> depth, root first */
+{
+    char root[256];
+
+    if (!object_root(md5, root, sizeof(root)))
+        snprintf(root, sizeof(root), "%s", md5);
+
+    xs *fn = _object_fn_by_md5(root, "object_thread");
+    fn = xs_replace_i(fn, ".json", "_t.idx");
+
+    xs *d = xs_number_new(0);
+    xs_dict *thread = xs_dict_new();
+    thread = xs_dict_append(thread, root, d);
+
+    return _object_thread_read(thread, fn);
+}
+
+
+static xs_list *_thread_below(const xs_dict *thread, const char *md5, int all)
+/* returns the direct replies (or all of them) to an entry of a conversation */
+{
+    xs_list *list = xs_list_new();
+    xs_dict *p    = (xs_dict *)thread;
+    xs_str *k;
+    xs_val *v;
+    int depth = -1;
+
+    while (xs_dict_iter(&p, &k, &v)) {
+        int d = (int)xs_number_get(v);
+
+        if (depth == -1) {
+            if (strcmp(k, md5) == 0)
+                depth = d;
+        }
+        else {
+            /* out of its replies? done */
+            if (d <= depth)
+                break;
+
+            if (all || d == depth + 1)
+                list = xs_list_append(list, k);
+        }
+    }
+
+    return list;
+}
+
+
+xs_list *thread_children(const xs_dict *thread, const char *md5)
+/* returns the direct replies to an entry of a conversation */
+{
+    return _thread_below(thread, md5, 0);
+}
+
+
+xs_list *thread_descendants(const xs_dict *thread, const char *md5)
+/* returns all replies to an entry of a conversation, in thread order */
+{
+    return _thread_below(thread, md5, 1);
+}
+
+
+xs_list *thread_ancestors(const xs_dict *thread, const char *md5)
+/* returns the ancestors of an entry of a conversation, the parent first */
+{
+    xs_list *list = xs_list_new();
+    xs_dict *p    = (xs_dict *)thread;
+    const char **path = NULL;
+    int size = 0;
+    xs_str *k;
+    xs_val *v;
+
+    /* keep the last entry seen at each depth: when
+       the entry is found, they are its ancestors */
+    while (xs_dict_iter(&p, &k, &v)) {
+        int d = (int)xs_number_get(v);
+
+        if (d < 0)
+            continue;
+
+        if (strcmp(k, md5) == 0) {
+            while (--d >= 0) {
+                if (d < size && path[d] != NULL)
+                    list = xs_list_append(list, path[d]);
+            }
+
+            break;
+        }
+
+        if (d >= size) {
+            path = xs_realloc(path, (d + 16) * sizeof(char *));
+            memset(path + size, '\0', (d + 16 - size) * sizeof(char *));
+            size = d + 16;
+        }
+
+        path[d] = k;
+    }
+
+    xs_free(path);
+
+    return list;
+}
+
+
+int object_admire(const char *id, const char *actor, int like)
+/* actor likes or announces this object */
+{
+    int status = 200;
+    xs *fn     = _object_fn(id);
+
+    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+
+    if (!index_in(fn, actor)) {
+        status = index_add(fn, actor);
+
+        srv_debug(1, xs_fmt("object_admire (%s) %s %s", like ? "Like" : "Announce", actor, fn));
+    }
+
+    return status;
+}
+
+
+int object_unadmire(const char *id, const char *actor, int like)
+/* actor no longer likes or announces this object */
+{
+    int status;
+    xs *fn = _object_fn(id);
+
+    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+
+    status = index_del(fn, actor);
+
+    srv_debug(0,
+        xs_fmt("object_unadmire (%s) %s %s %d", like ? "Like" : "Announce", actor, fn, status));
+
+    return status;
+}
+
+
+int _object_user_cache(snac *snac, const char *id, const char *cachedir, int del)
+/* adds or deletes from a user cache */
+{
+    xs *ofn = _object_fn(id);
+    xs *l   = xs_split(ofn, "/");
+    xs *cfn = xs_fmt("%s/%s/%s", snac->basedir, cachedir, xs_list_get(l, -1));
+    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, cachedir);
+    int ret;
+
+    if (del) {
+        ret = unlink(cfn);
+        index_del(idx, id);
+    }
+    else {
+        if ((ret = link(ofn, cfn)) != -1)
+            index_add(idx, id);
+    }
+
+    return ret;
+}
+
+
+int object_user_cache_add(snac *snac, const char *id, const char *cachedir)
+/* caches an object into a user cache */
+{
+    return _object_user_cache(snac, id, cachedir, 0);
+}
+
+
+int object_user_cache_del(snac *snac, const char *id, const char *cachedir)
+/* deletes an object from a user cache */
+{
+    return _object_user_cache(snac, id, cachedir, 1);
+}
+
+
+int object_user_cache_in(snac *snac, const char *id, const char *cachedir)
+/* checks if an object is stored in a cache */
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    xs *cfn = xs_fmt("%s/%s/%s.json", snac->basedir, cachedir, md5);
+
+    return !!(mtime(cfn) != 0.0);
+}
 
 
 xs_list *object_user_cache_list(snac *snac, const char *cachedir, int max, int inv)
@@ -1034,13 +1721,295 @@ int timeline_get_by_md5(snac *snac, const char *md5, xs_dict **msg)
 }
 
 
+
+
+/** top level timeline indexes **/
+
+/* private_top.idx and public_top.idx hold the top level entries of each
+   timeline in bump order: every new entry appends the top level entry of
+   its conversation, and readers keep only the last appearance of each */
+
+static xs_str *_timeline_top(snac *snac, const char *md5, xs_dict **threads)
+/* returns the top level entry for a timeline entry */
+{
+    const char *top = md5;
+    xs *anc = NULL;
+    char root[256];
+
+    if (object_root(md5, root, sizeof(root))) {
+        /* read every conversation only once */
+        const xs_dict *thread = xs_dict_get(*threads, root);
+
+        if (thread == NULL) {
+            xs *t = object_thread(root);
+            *threads = xs_dict_append(*threads, root, t);
+            thread   = xs_dict_get(*threads, root);
+        }
+
+        anc = thread_ancestors(thread, md5);
+        xs_list *p = anc;
+        xs_str *v;
+
+        /* move up while the ancestors are here */
+        while (xs_list_iter(&p, &v)) {
+            if (!timeline_here(snac, v))
+                break;
+
+            top = v;
+        }
+    }
+
+    return xs_str_new(top);
+}
+
+
+static xs_str *_timeline_top_fn(snac *snac, const char *idx_name)
+{
+    return xs_fmt("%s/%s_top.idx", snac->basedir, idx_name);
+}
+
+
+static pthread_mutex_t top_build_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int _timeline_top_build(snac *snac, const char *idx_name, int force)
+/* (re)builds a top level timeline index from the full one */
+{
+    xs *idx     = xs_fmt("%s/%s.idx", snac->basedir, idx_name);
+    xs *fn      = _timeline_top_fn(snac, idx_name);
+    xs *nfn     = xs_fmt("%s.new", fn);
+    xs *list    = xs_list_new();
+    xs *threads = xs_dict_new();
+    xs *tops    = NULL;
+    xs_set seen;
+    xs_list_idx x;
+    long size = 0;
+    int n = 0, k;
+    FILE *i, *o;
+
+    /* one build at a time; the ones waiting just use its result */
+    pthread_mutex_lock(&top_build_mutex);
+
+    if (!force && mtime(fn) != 0.0) {
+        pthread_mutex_unlock(&top_build_mutex);
+        return 0;
+    }
+
+    /* read the full index as it is now */
+    if ((i = fopen(idx, "r")) != NULL) {
+        struct stat st;
+        char line[256];
+
+        flock(fileno(i), LOCK_SH);
+
+        if (fstat(fileno(i), &st) != -1)
+            size = st.st_size;
+
+        while (ftell(i) < size && fgets(line, sizeof(line), i) != NULL) {
+            line[32] = '\0';
+
+            if (line[0] != '-')
+                list = xs_list_append(list, line);
+        }
+
+        fclose(i);
+    }
+
+    xs_set_init(&seen);
+
+    /* newest first, so that each top level entry stays at its last bump */
+    xs_list_idx_init(&x, list);
+
+    for (k = x.elems - 1; k >= 0; k--) {
+        const char *v = xs_list_idx_get(&x, k);
+
+        if (timeline_here(snac, v)) {
+            xs *top = _timeline_top(snac, v, &threads);
+            xs_set_add(&seen, top);
+        }
+    }
+
+    xs_list_idx_free(&x);
+
+    tops = xs_set_result(&seen);
+
+    if ((o = fopen(nfn, "w")) != NULL) {
+        xs_list_idx_init(&x, tops);
+
+        for (k = x.elems - 1; k >= 0; k--) {
+            fprintf(o, "%s\n", (char *)xs_list_idx_get(&x, k));
+            n++;
+        }
+
+        xs_list_idx_free(&x);
+
+        /* the entries are added under this lock: catch up with the
+           ones added meanwhile, so that none is lost by the rename() */
+        pthread_mutex_lock(&data_mutex);
+
+        if ((i = fopen(idx, "r")) != NULL) {
+            char line[256];
+
+            if (!fseek(i, size, SEEK_SET)) {
+                while (fgets(line, sizeof(line), i) != NULL) {
+                    line[32] = '\0';
+
+                    if (line[0] != '-' && timeline_here(snac, line)) {
+                        xs *top = _timeline_top(snac, line, &threads);
+                        fprintf(o, "%s\n", top);
+                        n++;
+                    }
+                }
+            }
+
+            fclose(i);
+        }
+
+        fclose(o);
+
+        rename(nfn, fn);
+
+        pthread_mutex_unlock(&data_mutex);
+    }
+
+    pthread_mutex_unlock(&top_build_mutex);
+
+    snac_debug(snac, 1, xs_fmt("_timeline_top_build %s %d", fn, n));
+
+    return n;
+}
+
+
+static int _timeline_top_compact(snac *snac, const char *idx_name)
+/* compacts a top level timeline index, dropping the deleted
+   entries and all but the last bump of each conversation */
+{
+    xs *fn  = _timeline_top_fn(snac, idx_name);
+    xs *nfn = xs_fmt("%s.new", fn);
+    xs *list = xs_list_new();
+    xs_set seen;
+    int n = 0;
+    FILE *i, *o;
+
+    xs_set_init(&seen);
+
+    pthread_mutex_lock(&data_mutex);
+
+    if ((i = fopen(fn, "r")) != NULL) {
+        flock(fileno(i), LOCK_EX);
+
+        char line[256];
+
+        while (fgets(line, sizeof(line), i) != NULL) {
+            line[32] = '\0';
+
+            if (line[0] != '-')
+                list = xs_list_append(list, line);
+        }
+
+        if ((o = fopen(nfn, "w")) != NULL) {
+            xs_list_idx x;
+            xs *tops;
+            int k;
+
+            xs_list_idx_init(&x, list);
+
+            /* newest first, keeping the last bump */
+            for (k = x.elems - 1; k >= 0; k--) {
+                const char *v = xs_list_idx_get(&x, k);
+
+                if (timeline_here(snac, v))
+                    xs_set_add(&seen, v);
+            }
+
+            xs_list_idx_free(&x);
+
+            tops = xs_set_result(&seen);
+            xs_list_idx_init(&x, tops);
+
+            for (k = x.elems - 1; k >= 0; k--) {
+                fprintf(o, "%s\n", (char *)xs_list_idx_get(&x, k));
+                n++;
+            }
+
+            xs_list_idx_free(&x);
+            fclose(o);
+
+            rename(nfn, fn);
+        }
+        else
+            xs_set_free(&seen);
+
+        fclose(i);
+    }
+    else
+        xs_set_free(&seen);
+
+    pthread_mutex_unlock(&data_mutex);
+
+    snac_debug(snac, 1, xs_fmt("_timeline_top_compact %s %d", fn, n));
+
+    return n;
+}
+
+
+static void _timeline_top_add(snac *snac, const char *idx_name, const char *md5)
+/* bumps the conversation of an entry in a top level timeline index */
+{
+    xs *fn = _timeline_top_fn(snac, idx_name);
+
+    /* not yet created? build it (this entry is already in the full index) */
+    if (mtime(fn) == 0.0)
+        _timeline_top_build(snac, idx_name, 0);
+    else {
+        xs *threads  = xs_dict_new();
+        xs *top      = _timeline_top(snac, md5, &threads);
+        xs *thread   = object_thread(md5);
+        xs *children = thread_children(thread, md5);
+
+        index_add_md5(fn, top);
+
+        /* replies that arrived before it are no longer top level entries */
+        if (xs_list_len(children))
+            index_del_md5_list(fn, children);
+    }
+}
+
+
+static void _timeline_cache_add(snac *snac, const char *id, const char *idx_name)
+/* adds an entry to a timeline and, if it's new, to its top level index */
+{
+    if (object_user_cache_add(snac, id, idx_name) != -1) {
+        xs *md5 = xs_md5_hex(id, strlen(id));
+        _timeline_top_add(snac, idx_name, md5);
+    }
+}
+
+
 int timeline_del(snac *snac, char *id)
 /* deletes a message from the timeline */
 {
+    xs *md5      = xs_md5_hex(id, strlen(id));
+    xs *thread   = object_thread(md5);
+    xs *children = thread_children(thread, md5);
+    xs_list *p;
+    xs_str *v;
+
     /* delete from the user's caches */
     object_user_cache_del(snac, id, "public");
     object_user_cache_del(snac, id, "private");
 
+    /* its replies are now top level entries */
+    p = children;
+    while (xs_list_iter(&p, &v)) {
+        xs *pub = xs_fmt("%s/public/%s.json", snac->basedir, v);
+
+        if (mtime(pub) > 0.0)
+            _timeline_top_add(snac, "public", v);
+
+        if (timeline_here(snac, v))
+            _timeline_top_add(snac, "private", v);
+    }
+
     /* try to delete the object if it's not used elsewhere */
     return object_del_if_unref(id);
 }
@@ -1049,7 +2018,7 @@ int timeline_del(snac *snac, char *id)
 void timeline_update_indexes(snac *snac, const char *id)
 /* updates the indexes */
 {
-    object_user_cache_add(snac, id, "private");
+    _timeline_cache_add(snac, id, "private");
 
     if (xs_startswith(id, snac->actor)) {
         xs *msg = NULL;
@@ -1057,7 +2026,7 @@ void timeline_update_indexes(snac *snac, const char *id)
         if (valid_status(object_get(id, &msg))) {
             /* if its ours and is public, also store in public */
             if (is_msg_public(snac, msg)) {
-                object_user_cache_add(snac, id, "public");
+                _timeline_cache_add(snac, id, "public");
 
                 /* also add it to the instance public timeline */
                 xs *ipt = xs_fmt("%s/public.idx", srv_basedir);
@@ -1085,12 +2054,15 @@ void timeline_admire(snac *snac, const char *id, const char *admirer, int like)
 {
     /* if we are admiring this, add to both timelines */
     if (!like && strcmp(admirer, snac->actor) == 0) {
-        object_user_cache_add(snac, id, "public");
-        object_user_cache_add(snac, id, "private");
+        _timeline_cache_add(snac, id, "public");
+        _timeline_cache_add(snac, id, "private");
     }
 
     object_admire(id, admirer, like);
 
+    /* the counts shown in the timeline changed */
+    timeline_touch(snac);
+
     snac_debug(snac, 1, xs_fmt("timeline_admire (%s) %s %s",
             like ? "Like" : "Announce", id, admirer));
 }
@@ -1102,31 +2074,14 @@ xs_list *timeline_top_level(snac *snac, xs_list *list)
     xs_set seen;
     xs_list *p;
     xs_str *v;
+    xs *threads = xs_dict_new();
 
     xs_set_init(&seen);
 
     p = list;
     while (xs_list_iter(&p, &v)) {
-        char line[256] = "";
-
-        strncpy(line, v, sizeof(line));
-
-        for (;;) {
-            char line2[256];
-
-            /* if it doesn't have a parent, use this */
-            if (!object_parent(line, line2, sizeof(line2)))
-                break;
-
-            /* well, there is a parent... but is it here? */
-            if (!timeline_here(snac, line2))
-                break;
-
-            /* it's here! try again with its own parent */
-            strncpy(line, line2, sizeof(line));
-        }
-
-        xs_set_add(&seen, line);
+        xs *top = _timeline_top(snac, v, &threads);
+        xs_set_add(&seen, top);
     }
 
     return xs_set_result(&seen);
@@ -1154,9 +2109,73 @@ xs_list *timeline_simple_list(snac *snac, const char *idx_name, int skip, int sh
 xs_list *timeline_list(snac *snac, const char *idx_name, int skip, int show)
 /* returns a timeline (only top level entries) */
 {
-    xs *list = timeline_simple_list(snac, idx_name, skip, show);
+    int c_max;
+
+    /* maximum number of items in the timeline */
+    c_max = xs_number_get(xs_dict_get(srv_config, "max_timeline_entries"));
+
+    /* never more timeline entries than the configured maximum */
+    if (show > c_max)
+        show = c_max;
+
+    xs *fn = _timeline_top_fn(snac, idx_name);
+
+    if (mtime(fn) == 0.0)
+        _timeline_top_build(snac, idx_name, 0);
+
+    xs_list *list = xs_list_new();
+    xs *threads   = xs_dict_new();
+    xs_set seen, tops;
+    int n = 0, bad = 0;
+    FILE *f;
+
+    xs_set_init(&seen);
+    xs_set_init(&tops);
+
+    if ((f = fopen(fn, "r")) != NULL) {
+        flock(fileno(f), LOCK_SH);
 
-    return timeline_top_level(snac, list);
+        char line[256];
+
+        /* read it backwards, until the page is full */
+        if (!fseek(f, 0, SEEK_END) && !fseek(f, -33, SEEK_CUR)) {
+            while (xs_list_len(list) < show && fgets(line, sizeof(line), f) != NULL) {
+                /* the offsets below need fixed size lines */
+                if (strlen(line) != 33 || line[32] != '\n') {
+                    bad = 1;
+                    break;
+                }
+
+                line[32] = '\0';
+
+                /* only the last bump of each conversation counts;
+                   entries may also have been deleted or got a parent since */
+                if (line[0] != '-' && xs_set_add(&seen, line) && timeline_here(snac, line)) {
+                    xs *top = _timeline_top(snac, line, &threads);
+
+                    if (xs_set_add(&tops, top) && n++ >= skip)
+                        list = xs_list_append(list, top);
+                }
+
+                /* move backwards 2 entries */
+                if (fseek(f, -66, SEEK_CUR) == -1)
+                    break;
+            }
+        }
+
+        fclose(f);
+    }
+
+    /* rebuild it from the full index for the next time */
+    if (bad) {
+        srv_log(xs_fmt("timeline_list: corrupted index %s", fn));
+        _timeline_top_build(snac, idx_name, 1);
+    }
+
+    xs_set_free(&tops);
+    xs_set_free(&seen);
+
+    return list;
 }
 
 
@@ -1190,9 +2209,7 @@ int following_add(snac *snac, const char *actor, const xs_dict *msg)
     FILE *f;
 
     if ((f = fopen(fn, "w")) != NULL) {
-        xs *j = xs_json_dumps_pp(msg, 4);
-
-        fwrite(j, 1, strlen(j), f);
+        xs_json_dump(msg, 4, f);
         fclose(f);
 
         /* get the filename of the actor object */
@@ -1308,6 +2325,184 @@ xs_list *following_list(snac *snac)
 }
 
 
+/** moderation sets **/
+
+/* the ids stored in the muted/, hidden/ and pinned/ subdirectories are kept
+   in memory, shared by all threads, as they are checked for every entry shown
+   (so there is no need to hash each id into a file name and stat() it);
+   a set is reloaded when the mtime of its subdirectory changes
+   (e.g. when modified by a command line invocation or the purge).
+   The instance blocks in the server block/ subdirectory are also kept here */
+
+typedef struct {
+    char *dir;              /* the user subdirectory */
+    double mtime;           /* its mtime when loaded */
+    time_t loaded;          /* when it was loaded */
+    time_t checked;         /* when its mtime was last checked */
+    xs_set set;             /* the ids in the files inside */
+} mod_set;
+
+static pthread_mutex_t mod_sets_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mod_set *mod_sets = NULL;
+static int mod_sets_n = 0;
+
+#ifndef MOD_SET_CHECK_SECS
+#define MOD_SET_CHECK_SECS 1
+#endif
+
+static void _mod_set_dirty(mod_set *m)
+/* forces a reload of the set on next use (sets cannot delete) */
+{
+    m->mtime   = -1.0;
+    m->checked = 0;
+}
+
+
+static xs_str *_instance_host(const char *instance)
+/* returns the lowercase host name of an instance, url or id */
+{
+    const char *p = strstr(instance, ":/" "/");
+
+    p = p ? p + 3 : instance;
+
+    return xs_tolower_i(xs_crop_i(xs_str_new(p), 0, strcspn(p, "/:?#\"")));
+}
+
+
+static mod_set *_mod_set(const char *dir, int hosts)
+/* returns the set for a subdirectory (mod_sets_mutex must be locked);
+   if hosts is set, the stored ids are converted to host names */
+{
+    time_t t = time(NULL);
+    mod_set *m = NULL;
+    double mt;
+    int n;
+
+    for (n = 0; n < mod_sets_n; n++) {
+        if (strcmp(mod_sets[n].dir, dir) == 0) {
+            m = &mod_sets[n];
+            break;
+        }
+    }
+
+    if (m == NULL) {
+        /* first time for this one */
+        mod_sets = realloc(mod_sets, (mod_sets_n + 1) * sizeof(mod_set));
+        m = &mod_sets[mod_sets_n++];
+
+        m->dir     = strdup(dir);
+        m->loaded  = 0;
+        m->set.list = NULL;
+        m->set.hash = NULL;
+
+        _mod_set_dirty(m);
+    }
+    else
+    if (t - m->checked < MOD_SET_CHECK_SECS)
+        return m;
+
+    m->checked = t;
+    mt = mtime(dir);
+
+    /* the mtime has a resolution of seconds, so a change made
+       in the same second the set was loaded could go unnoticed */
+    if (mt != m->mtime || mt >= (double) m->loaded) {
+        xs *spec  = xs_fmt("%s/*", dir);
+        xs *files = xs_glob(spec, 0, 0);
+        xs_set *s = &m->set;
+        char *p, *v;
+
+        if (s->list != NULL)
+            xs_set_free(s);
+
+        xs_set_init(s);
+
+        p = files;
+        while (xs_list_iter(&p, &v)) {
+            FILE *f;
+
+            if ((f = fopen(v, "r")) != NULL) {
+                xs *id = NULL;
+
+                if (xs_endswith(v, ".json")) {
+                    /* a link to the object */
+                    xs *j   = xs_readall(f);
+                    xs *obj = xs_json_loads(j);
+                    const char *oid = xs_dict_get(obj, "id");
+
+                    if (xs_type(oid) == XSTYPE_STRING)
+                        id = xs_dup(oid);
+                }
+                else {
+                    /* the id is in the first line */
+                    id = xs_strip_i(xs_readline(f));
+                }
+
+                fclose(f);
+
+                if (hosts && !xs_is_null(id)) {
+                    xs_str *h = _instance_host(id);
+                    xs_free(id);
+                    id = h;
+                }
+
+                if (!xs_is_null(id) && *id)
+                    xs_set_add(s, id);
+            }
+        }
+
+        /* these outlive the request */
+        s->list = xs_arena_promote(s->list);
+        s->hash = xs_arena_promote(s->hash);
+
+        m->mtime  = mt;
+        m->loaded = t;
+
+        srv_debug(2, xs_fmt("_mod_set loaded %s (%d)", dir, xs_list_len(s->list)));
+    }
+
+    return m;
+}
+
+
+static int _mod_set_in(snac *user, const char *subdir, const char *id)
+/* checks if id is in a user set */
+{
+    int ret;
+
+    if (xs_is_null(id))
+        return 0;
+
+    xs *dir = xs_fmt("%s/%s", user->basedir, subdir);
+
+    pthread_mutex_lock(&mod_sets_mutex);
+
+    ret = xs_set_in(&_mod_set(dir, 0)->set, id);
+
+    pthread_mutex_unlock(&mod_sets_mutex);
+
+    return ret;
+}
+
+
+static void _mod_set_update(snac *user, const char *subdir, const char *id, int add)
+/* updates a user set after adding or deleting the file for id */
+{
+    xs *dir = xs_fmt("%s/%s", user->basedir, subdir);
+
+    pthread_mutex_lock(&mod_sets_mutex);
+
+    mod_set *m = _mod_set(dir, 0);
+
+    if (add)
+        xs_set_add(&m->set, id);
+    else
+        _mod_set_dirty(m);
+
+    pthread_mutex_unlock(&mod_sets_mutex);
+}
+
+
 xs_str *_muted_fn(snac *snac, const char *actor)
 {
     xs *md5 = xs_md5_hex(actor, strlen(actor));
@@ -1325,6 +2520,8 @@ void mute(snac *snac, const char *actor)
         fprintf(f, "%s\n", actor);
         fclose(f);
 
+        _mod_set_update(snac, "muted", actor, 1);
+
         snac_debug(snac, 2, xs_fmt("muted %s %s", actor, fn));
     }
 }
@@ -1337,6 +2534,8 @@ void unmute(snac *snac, const char *actor)
 
     unlink(fn);
 
+    _mod_set_update(snac, "muted", actor, 0);
+
     snac_debug(snac, 2, xs_fmt("unmuted %s %s", actor, fn));
 }
 
@@ -1344,26 +2543,16 @@ void unmute(snac *snac, const char *actor)
 int is_muted(snac *snac, const char *actor)
 /* check if someone is muted */
 {
-    xs *fn = _muted_fn(snac, actor);
-
-    return !!(mtime(fn) != 0.0);
+    return _mod_set_in(snac, "muted", actor);
 }
 
 
 /** pinning **/
 
-xs_str *_pinned_fn(snac *user, const char *id)
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return xs_fmt("%s/pinned/%s.json", user->basedir, md5);
-}
-
-
 int is_pinned(snac *user, const char *id)
 /* returns true if this note is pinned */
 {
-    xs *fn = _pinned_fn(user, id);
-    return !!(mtime(fn) != 0.0);
+    return _mod_set_in(user, "pinned", id);
 }
 
 
@@ -1381,6 +2570,9 @@ int pin(snac *user, const char *id)
             mkdirx(fn);
 
             ret = object_user_cache_add(user, id, "pinned");
+
+            if (ret != -1)
+                _mod_set_update(user, "pinned", id, 1);
         }
     }
 
@@ -1397,6 +2589,8 @@ int unpin(snac *user, const char *id)
         /* delete from the index */
         xs *idx = xs_fmt("%s/pinned.idx", user->basedir);
         index_del(idx, id);
+
+        _mod_set_update(user, "pinned", id, 0);
     }
 
     return ret;
@@ -1427,6 +2621,8 @@ void hide(snac *snac, const char *id)
         fprintf(f, "%s\n", id);
         fclose(f);
 
+        _mod_set_update(snac, "hidden", id, 1);
+
         snac_debug(snac, 2, xs_fmt("hidden %s %s", id, fn));
 
         /* hide all the children */
@@ -1450,9 +2646,7 @@ void hide(snac *snac, const char *id)
 int is_hidden(snac *snac, const char *id)
 /* check is id is hidden */
 {
-    xs *fn = _hidden_fn(snac, id);
-
-    return !!(mtime(fn) != 0.0);
+    return _mod_set_in(snac, "hidden", id);
 }
 
 
@@ -1551,7 +2745,7 @@ int static_get(snac *snac, const char *id, xs_val **data, int *size,
             xs *e = xs_fmt("W/\"snac-%.0lf\"", tm);
 
             /* if if-none-match is set, check if it's the same */
-            if (!xs_is_null(inm) && strcmp(e, inm) == 0) {
+            if (etag_match(inm, e)) {
                 /* client has the newest version */
                 status = 304;
             }
@@ -1632,6 +2826,151 @@ xs_str *static_get_meta(snac *snac, const char *id)
 }
 
 
+/** etags **/
+
+static xs_str *_etag_add(xs_str *seed, const char *fn)
+/* adds the identity of a file (mtime, size and inode) to an etag seed */
+{
+    struct stat st;
+    xs *s = NULL;
+
+    if (fn && stat(fn, &st) != -1)
+        s = xs_fmt("|%ld.%09ld:%lld:%lld",
+                (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec,
+                (long long)st.st_size, (long long)st.st_ino);
+    else
+        s = xs_str_new("|-");
+
+    return xs_str_cat(seed, s);
+}
+
+
+static xs_str *_etag_add_obj(xs_str *seed, const char *md5)
+/* adds the state of an object and its likes, announces
+   and children indexes to an etag seed */
+{
+    const char *sfx[] = { "_l.idx", "_a.idx", "_c.idx", NULL };
+    xs *fn = _object_fn_by_md5(md5, "_etag_add_obj");
+    int n;
+
+    seed = _etag_add(seed, fn);
+
+    for (n = 0; sfx[n] != NULL; n++) {
+        xs *ifn = xs_replace(fn, ".json", sfx[n]);
+        seed = _etag_add(seed, ifn);
+    }
+
+    return seed;
+}
+
+
+static xs_str *_etag_build(snac *user, const char *extra, const char *files[],
+                           const char *obj_id, const xs_list *md5s)
+{
+    xs *seed = xs_fmt("%s|%s|%s", USER_AGENT,
+                user ? user->uid : "", extra ? extra : "");
+    const char *base = user ? user->basedir : srv_basedir;
+    int n;
+
+    /* the server configuration and style affect everything */
+    xs *cfn = xs_fmt("%s/server.json", srv_basedir);
+    xs *sfn = xs_fmt("%s/style.css", srv_basedir);
+    seed = _etag_add(seed, cfn);
+    seed = _etag_add(seed, sfn);
+
+    for (n = 0; files != NULL && files[n] != NULL; n++) {
+        xs *fn = xs_fmt("%s/%s", base, files[n]);
+        seed = _etag_add(seed, fn);
+    }
+
+    if (obj_id != NULL) {
+        xs *ofn = _object_fn(obj_id);
+        seed = _etag_add(seed, ofn);
+    }
+
+    if (md5s != NULL) {
+        xs_list *p = (xs_list *)md5s;
+        xs_str *v;
+
+        while (xs_list_iter(&p, &v))
+            seed = _etag_add_obj(seed, v);
+    }
+
+    xs *md5 = xs_md5_hex(seed, strlen(seed));
+
+    return xs_fmt("\"snac-%s\"", md5);
+}
+
+
+xs_str *etag_build(snac *user, const char *extra, const char *files[], const char *obj_id)
+/* builds a strong etag from the state of a set of files (relative to
+   the user directory, or to the server directory if there is no user),
+   an optional stored object and an extra discriminating string */
+{
+    return _etag_build(user, extra, files, obj_id, NULL);
+}
+
+
+xs_str *etag_build_list(snac *user, const char *extra, const char *files[], const xs_list *md5s)
+/* like etag_build(), but also from the state of a list of objects (by md5),
+   as they can be rewritten, liked or replied to without touching any index */
+{
+    return _etag_build(user, extra, files, NULL, md5s);
+}
+
+
+xs_str *etag_build_threads(snac *user, const char *extra, const char *files[], const xs_list *md5s)
+/* like etag_build_list(), but also from the state of all the replies
+   to each entry, as they are shown along with it */
+{
+    xs *all    = xs_list_new();
+    xs_list *p = (xs_list *)md5s;
+    xs_str *v;
+
+    while (xs_list_iter(&p, &v)) {
+        xs *thread = object_thread(v);
+        xs *desc   = thread_descendants(thread, v);
+
+        all = xs_list_append(all, v);
+        all = xs_list_cat(all, desc);
+    }
+
+    return _etag_build(user, extra, files, NULL, all);
+}
+
+
+int etag_match(const char *inm, const char *etag)
+/* checks if an If-None-Match header matches an etag */
+{
+    if (xs_is_null(inm) || xs_is_null(etag))
+        return 0;
+
+    xs *l = xs_split(inm, ",");
+    xs_list *p = l;
+    xs_str *v;
+
+    while (xs_list_iter(&p, &v)) {
+        xs *s = xs_strip_i(xs_dup(v));
+        const char *e = s;
+
+        if (strcmp(e, "*") == 0)
+            return 1;
+
+        /* If-None-Match uses the weak comparison function */
+        if (xs_startswith(e, "W/"))
+            e += 2;
+
+        if (xs_startswith(etag, "W/"))
+            etag += 2;
+
+        if (strcmp(e, etag) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+
 /** history **/
 
 xs_str *_history_fn(snac *snac, const char *id)
@@ -1703,32 +3042,201 @@ xs_list *history_list(snac *snac)
 }
 
 
+double lastlog_get(snac *snac)
+/* returns the last time the user logged in, or 0.0 */
+{
+    xs *fn = xs_fmt("%s/lastlog.txt", snac->basedir);
+    double t = 0.0;
+    FILE *f;
+
+    if ((f = fopen(fn, "r")) != NULL) {
+        if (fscanf(f, "%lf", &t) != 1)
+            t = 0.0;
+
+        fclose(f);
+    }
+
+    return t;
+}
+
+
+/* logins are checked on every authenticated request, so the
+   last login of each user is written at most once a minute */
+
+#ifndef LASTLOG_WRITE_SECS
+#define LASTLOG_WRITE_SECS 60
+#endif
+
+static pthread_mutex_t lastlog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xs_dict *lastlog_written = NULL; /* uid: time */
+
+
 void lastlog_write(snac *snac, const char *source)
 /* writes the last time the user logged in */
 {
+    xs *t = xs_number_new(time(NULL));
+    const char *v;
+    int skip = 0;
+
+    pthread_mutex_lock(&lastlog_mutex);
+
+    if (lastlog_written == NULL)
+        lastlog_written = xs_arena_promote(xs_dict_new());
+
+    if ((v = xs_dict_get(lastlog_written, snac->uid)) != NULL &&
+        xs_number_get(t) - xs_number_get(v) < LASTLOG_WRITE_SECS)
+        skip = 1;
+    else
+        lastlog_written = xs_dict_set(lastlog_written, snac->uid, t);
+
+    pthread_mutex_unlock(&lastlog_mutex);
+
+    if (skip)
+        return;
+
     xs *fn = xs_fmt("%s/lastlog.txt", snac->basedir);
     FILE *f;
 
+    double now = ftime();
+
     if ((f = fopen(fn, "w")) != NULL) {
-        fprintf(f, "%lf %s\n", ftime(), source);
+        fprintf(f, "%lf %s\n", now, source);
         fclose(f);
     }
+
+    _user_dir_lastlog(snac->uid, now);
 }
 
 
 /** inbox collection **/
 
-void inbox_add(const char *inbox)
-/* collects a shared inbox */
+/* the shared inboxes of other instances are kept in a registry stored
+   in inbox.json (as inbox url: last time seen) and kept in memory;
+   the inboxes seen are gathered in a set and merged into the registry
+   from time to time, dropping the ones not seen for a while */
+
+#ifndef INBOX_FLUSH_SECS
+#define INBOX_FLUSH_SECS 600
+#endif
+
+#ifndef INBOX_MAX_DAYS
+#define INBOX_MAX_DAYS 7
+#endif
+
+static pthread_mutex_t inbox_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xs_dict *inbox_reg = NULL;       /* the registry, as stored */
+static xs_dict_idx inbox_reg_idx;       /* its index */
+static xs_set inbox_seen;               /* inboxes seen since last flush */
+static time_t inbox_flushed = 0;
+
+
+static xs_dict *_inbox_read(void)
+/* reads the registry from disk */
 {
-    xs *md5 = xs_md5_hex(inbox, strlen(inbox));
-    xs *fn  = xs_fmt("%s/inbox/%s", srv_basedir, md5);
+    xs *fn = xs_fmt("%s/inbox.json", srv_basedir);
+    xs_dict *reg = NULL;
     FILE *f;
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        fprintf(f, "%s\n", inbox);
+    if ((f = fopen(fn, "r")) != NULL) {
+        xs *j = xs_readall(f);
+        fclose(f);
+
+        reg = xs_json_loads(j);
+    }
+
+    if (xs_type(reg) != XSTYPE_DICT) {
+        xs_free(reg);
+        reg = xs_dict_new();
+    }
+
+    return reg;
+}
+
+
+static void _inbox_set(xs_dict *reg)
+/* sets the in-memory registry (inbox_mutex must be locked) */
+{
+    if (inbox_reg != NULL) {
+        xs_dict_idx_free(&inbox_reg_idx);
+        xs_free(inbox_reg);
+        xs_set_free(&inbox_seen);
+    }
+
+    /* these outlive the request */
+    inbox_reg = xs_arena_promote(reg);
+
+    xs_dict_idx_init(&inbox_reg_idx, inbox_reg);
+    inbox_reg_idx.hash = xs_arena_promote(inbox_reg_idx.hash);
+
+    xs_set_init(&inbox_seen);
+    inbox_seen.list = xs_arena_promote(inbox_seen.list);
+    inbox_seen.hash = xs_arena_promote(inbox_seen.hash);
+
+    inbox_flushed = time(NULL);
+}
+
+
+static void _inbox_flush(void)
+/* merges the inboxes seen into the registry and writes it (inbox_mutex must be locked) */
+{
+    xs *fn   = xs_fmt("%s/inbox.json", srv_basedir);
+    xs *nfn  = xs_fmt("%s/inbox.json.new", srv_basedir);
+    xs *now  = xs_number_new((double) time(NULL));
+    double limit = (double) time(NULL) - INBOX_MAX_DAYS * 24 * 3600;
+    xs_dict *reg = xs_dict_new();
+    char *p, *k, *v;
+    FILE *f;
+
+    /* start from what's on disk, as other processes may have written it */
+    xs *old = _inbox_read();
+
+    p = old;
+    while (xs_dict_iter(&p, &k, &v)) {
+        if (xs_set_in(&inbox_seen, k))
+            continue;
+
+        if (xs_type(v) == XSTYPE_NUMBER && xs_number_get(v) >= limit)
+            reg = xs_dict_append(reg, k, v);
+    }
+
+    p = inbox_seen.list;
+    while (xs_list_iter(&p, &v))
+        reg = xs_dict_append(reg, v, now);
+
+    if ((f = fopen(nfn, "w")) != NULL) {
+        xs_json_dump(reg, 0, f);
         fclose(f);
+
+        rename(nfn, fn);
     }
+    else
+        srv_log(xs_fmt("cannot write '%s'", fn));
+
+    _inbox_set(reg);
+}
+
+
+static void _inbox_load(void)
+/* loads the registry, if not already done (inbox_mutex must be locked) */
+{
+    if (inbox_reg == NULL)
+        _inbox_set(_inbox_read());
+}
+
+
+void inbox_add(const char *inbox)
+/* collects a shared inbox */
+{
+    pthread_mutex_lock(&inbox_mutex);
+
+    _inbox_load();
+
+    xs_set_add(&inbox_seen, inbox);
+
+    if (time(NULL) - inbox_flushed >= INBOX_FLUSH_SECS)
+        _inbox_flush();
+
+    pthread_mutex_unlock(&inbox_mutex);
 }
 
 
@@ -1747,30 +3255,46 @@ xs_list *inbox_list(void)
 /* returns the collected inboxes as a list */
 {
     xs_list *ibl = xs_list_new();
-    xs *spec     = xs_fmt("%s/inbox/" "*", srv_basedir);
-    xs *files    = xs_glob(spec, 0, 0);
-    xs_list *p   = files;
-    xs_val *v;
+    double limit = (double) time(NULL) - INBOX_MAX_DAYS * 24 * 3600;
+    char *p, *k, *v;
 
-    while (xs_list_iter(&p, &v)) {
-        FILE *f;
+    pthread_mutex_lock(&inbox_mutex);
 
-        if ((f = fopen(v, "r")) != NULL) {
-            xs *line = xs_readline(f);
+    _inbox_load();
 
-            if (line) {
-                line = xs_strip_i(line);
-                ibl  = xs_list_append(ibl, line);
-            }
+    p = inbox_reg;
+    while (xs_dict_iter(&p, &k, &v)) {
+        if (xs_number_get(v) >= limit || xs_set_in(&inbox_seen, k))
+            ibl = xs_list_append(ibl, k);
+    }
 
-            fclose(f);
-        }
+    p = inbox_seen.list;
+    while (xs_list_iter(&p, &v)) {
+        if (xs_dict_idx_get(&inbox_reg_idx, v) == NULL)
+            ibl = xs_list_append(ibl, v);
     }
 
+    pthread_mutex_unlock(&inbox_mutex);
+
     return ibl;
 }
 
 
+void inbox_flush(int force)
+/* writes the inbox registry, if there is something new or forced */
+{
+    pthread_mutex_lock(&inbox_mutex);
+
+    if (force)
+        _inbox_load();
+
+    if (inbox_reg != NULL && (force || xs_list_len(inbox_seen.list)))
+        _inbox_flush();
+
+    pthread_mutex_unlock(&inbox_mutex);
+}
+
+
 /** instance-wide operations **/
 
 xs_str *_instance_block_fn(const char *instance)
@@ -1785,10 +3309,37 @@ xs_str *_instance_block_fn(const char *instance)
 
 
 int is_instance_blocked(const char *instance)
+/* checks if the instance, or any domain above it, is blocked */
 {
-    xs *fn = _instance_block_fn(instance);
+    xs *dir  = xs_fmt("%s/block", srv_basedir);
+    xs *host = _instance_host(instance);
+    const char *p = host;
+    int ret = 0;
 
-    return !!(mtime(fn) != 0.0);
+    pthread_mutex_lock(&mod_sets_mutex);
+
+    xs_set *s = &_mod_set(dir, 1)->set;
+
+    /* try host.example.com, example.com and com */
+    while (p != NULL && *p && !(ret = xs_set_in(s, p))) {
+        if ((p = strchr(p, '.')) != NULL)
+            p++;
+    }
+
+    pthread_mutex_unlock(&mod_sets_mutex);
+
+    return ret;
+}
+
+
+static void _instance_block_dirty(void)
+/* forces a reload of the instance blocks */
+{
+    xs *dir = xs_fmt("%s/block", srv_basedir);
+
+    pthread_mutex_lock(&mod_sets_mutex);
+    _mod_set_dirty(_mod_set(dir, 1));
+    pthread_mutex_unlock(&mod_sets_mutex);
 }
 
 
@@ -1809,6 +3360,8 @@ int instance_block(const char *instance)
             fprintf(f, "%s\n", instance);
             fclose(f);
 
+            _instance_block_dirty();
+
             ret = 0;
         }
         else
@@ -1824,11 +3377,14 @@ int instance_block(const char *instance)
 int instance_unblock(const char *instance)
 /* unblocks a full instance */
 {
+    xs *fn = _instance_block_fn(instance);
     int ret;
 
-    if (is_instance_blocked(instance)) {
-        xs *fn = _instance_block_fn(instance);
+    /* only exact blocks can be removed (not the domain above) */
+    if (mtime(fn) != 0.0) {
         ret = unlink(fn);
+
+        _instance_block_dirty();
     }
     else
         ret = -2;
@@ -1839,31 +3395,123 @@ int instance_unblock(const char *instance)
 
 /** notifications **/
 
-xs_str *notify_check_time(snac *snac, int reset)
-/* gets or resets the latest notification check time */
+/* the notification ids are time-based and added under data_mutex, so they
+   are stored sorted in notify.idx as fixed size lines; notify_seen.txt
+   keeps how many of them have already been seen */
+
+#define NOTIFY_IDX_LINE 18  /* a tid and a newline */
+
+static xs_str *_notify_idx(snac *snac)
+/* returns the notification index file name, building it if needed */
 {
-    xs_str *t = NULL;
-    xs *fn    = xs_fmt("%s/notifydate.txt", snac->basedir);
-    FILE *f;
+    xs_str *fn = xs_fmt("%s/notify.idx", snac->basedir);
 
-    if (reset) {
-        if ((f = fopen(fn, "w")) != NULL) {
-            t = tid(0);
-            fprintf(f, "%s\n", t);
+    if (mtime(fn) != 0.0)
+        return fn;
+
+    pthread_mutex_lock(&data_mutex);
+
+    if (mtime(fn) == 0.0) {
+        /* build it from the notification files */
+        xs *spec  = xs_fmt("%s/notify/" "*.json", snac->basedir);
+        xs *lst   = xs_glob(spec, 1, 0);
+        xs *nfn   = xs_fmt("%s.new", fn);
+        xs *d_fn  = xs_fmt("%s/notifydate.txt", snac->basedir);
+        xs *s_fn  = xs_fmt("%s/notify_seen.txt", snac->basedir);
+        xs *t     = NULL;
+        char *p, *v;
+        int seen  = 0;
+        FILE *f;
+
+        /* the old way of storing the last check time */
+        if ((f = fopen(d_fn, "r")) != NULL) {
+            t = xs_strip_i(xs_readline(f));
             fclose(f);
         }
-    }
-    else {
-        if ((f = fopen(fn, "r")) != NULL) {
-            t = xs_readline(f);
+
+        if ((f = fopen(nfn, "w")) != NULL) {
+            p = lst;
+            while (xs_list_iter(&p, &v)) {
+                if (strlen(v) != NOTIFY_IDX_LINE - 1 + 5)
+                    continue;
+
+                fprintf(f, "%.*s\n", NOTIFY_IDX_LINE - 1, v);
+
+                if (t != NULL && strncmp(v, t, NOTIFY_IDX_LINE - 1) <= 0)
+                    seen++;
+            }
+
             fclose(f);
+
+            if ((f = fopen(s_fn, "w")) != NULL) {
+                fprintf(f, "%d\n", seen);
+                fclose(f);
+            }
+
+            rename(nfn, fn);
+            unlink(d_fn);
+
+            srv_debug(1, xs_fmt("_notify_idx built %s", fn));
         }
-        else
-            /* never set before */
-            t = xs_fmt("%16.6f", 0.0);
     }
 
-    return t;
+    pthread_mutex_unlock(&data_mutex);
+
+    return fn;
+}
+
+
+static int _notify_len(snac *snac)
+/* returns the number of notifications */
+{
+    xs *fn = _notify_idx(snac);
+    struct stat st;
+
+    if (stat(fn, &st) == -1)
+        return 0;
+
+    return st.st_size / NOTIFY_IDX_LINE;
+}
+
+
+static int _notify_seen_len(snac *snac)
+/* returns the number of already seen notifications */
+{
+    xs *fn = xs_fmt("%s/notify_seen.txt", snac->basedir);
+    int n  = 0;
+    FILE *f;
+
+    if ((f = fopen(fn, "r")) != NULL) {
+        if (fscanf(f, "%d", &n) != 1)
+            n = 0;
+
+        fclose(f);
+    }
+
+    return n;
+}
+
+
+int notify_new_len(snac *snac)
+/* returns the number of new (unseen) notifications */
+{
+    int n = _notify_len(snac) - _notify_seen_len(snac);
+
+    return n > 0 ? n : 0;
+}
+
+
+void notify_seen(snac *snac)
+/* marks all notifications as seen */
+{
+    xs *fn = xs_fmt("%s/notify_seen.txt", snac->basedir);
+    int n  = _notify_len(snac);
+    FILE *f;
+
+    if (n != _notify_seen_len(snac) && (f = fopen(fn, "w")) != NULL) {
+        fprintf(f, "%d\n", n);
+        fclose(f);
+    }
 }
 
 
@@ -1871,13 +3519,19 @@ void notify_add(snac *snac, const char *type, const char *utype,
                 const char *actor, const char *objid)
 /* adds a new notification */
 {
-    xs *ntid = tid(0);
+    xs *idx  = _notify_idx(snac);
     xs *fn   = xs_fmt("%s/notify/", snac->basedir);
     xs *date = xs_str_utctime(0, ISO_DATE_SPEC);
     FILE *f;
 
     /* create the directory */
     mkdirx(fn);
+
+    /* the id is created under the lock, to keep the index sorted */
+    pthread_mutex_lock(&data_mutex);
+
+    xs *ntid = tid(0);
+
     fn = xs_str_cat(fn, ntid);
     fn = xs_str_cat(fn, ".json");
 
@@ -1893,11 +3547,19 @@ void notify_add(snac *snac, const char *type, const char *utype,
         noti = xs_dict_append(noti, "objid", objid);
 
     if ((f = fopen(fn, "w")) != NULL) {
-        xs *j = xs_json_dumps_pp(noti, 4);
-
-        fwrite(j, strlen(j), 1, f);
+        xs_json_dump(noti, 4, f);
         fclose(f);
+
+        if ((f = fopen(idx, "a")) != NULL) {
+            flock(fileno(f), LOCK_EX);
+            fseek(f, 0, SEEK_END);
+
+            fprintf(f, "%s\n", ntid);
+            fclose(f);
+        }
     }
+
+    pthread_mutex_unlock(&data_mutex);
 }
 
 
@@ -1919,29 +3581,88 @@ xs_dict *notify_get(snac *snac, const char *id)
 }
 
 
-xs_list *notify_list(snac *snac, int new_only)
-/* returns a list of notification ids, optionally only the new ones */
+static int _notify_find(FILE *f, int n, const char *id)
+/* returns the number of notifications in the index older than id */
 {
-    xs *t = NULL;
+    char line[NOTIFY_IDX_LINE];
+    int lo = 0;
+    int hi = n;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        fseek(f, mid * NOTIFY_IDX_LINE, SEEK_SET);
+
+        if (fread(line, NOTIFY_IDX_LINE, 1, f) != 1)
+            break;
 
-    /* if only new ones are requested, get the last time */
-    if (new_only)
-        t = notify_check_time(snac, 0);
+        line[NOTIFY_IDX_LINE - 1] = '\0';
 
-    xs *spec     = xs_fmt("%s/notify/" "*.json", snac->basedir);
-    xs *lst      = xs_glob(spec, 1, 1);
+        if (strcmp(line, id) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+
+xs_list *notify_list(snac *snac, const char *max_id, const char *since_id, int show)
+/* returns a list of up to show notification ids, newest first,
+   optionally only older than max_id and newer than since_id */
+{
+    xs *fn       = _notify_idx(snac);
     xs_list *out = xs_list_new();
-    xs_list *p   = lst;
-    xs_str *v;
+    FILE *f;
 
-    while (xs_list_iter(&p, &v)) {
-        xs *id = xs_replace(v, ".json", "");
+    if ((f = fopen(fn, "r")) != NULL) {
+        int from, to;
 
-        /* old? */
-        if (t != NULL && strcmp(id, t) < 0)
-            continue;
+        flock(fileno(f), LOCK_SH);
+
+        fseek(f, 0, SEEK_END);
+        to = ftell(f) / NOTIFY_IDX_LINE;
+
+        if (!xs_is_null(max_id))
+            to = _notify_find(f, to, max_id);
 
-        out = xs_list_append(out, id);
+        from = show < to ? to - show : 0;
+
+        if (!xs_is_null(since_id)) {
+            int n = _notify_find(f, to, since_id);
+
+            /* skip since_id itself */
+            if (n < to) {
+                char line[NOTIFY_IDX_LINE];
+
+                fseek(f, n * NOTIFY_IDX_LINE, SEEK_SET);
+
+                if (fread(line, NOTIFY_IDX_LINE, 1, f) == 1 &&
+                    strncmp(line, since_id, NOTIFY_IDX_LINE - 1) == 0)
+                    n++;
+            }
+
+            if (n > from)
+                from = n;
+        }
+
+        if (from < to) {
+            xs *buf = xs_realloc(NULL, (to - from) * NOTIFY_IDX_LINE);
+
+            fseek(f, from * NOTIFY_IDX_LINE, SEEK_SET);
+
+            if (fread(buf, NOTIFY_IDX_LINE, to - from, f) == (size_t)(to - from)) {
+                while (to-- > from) {
+                    char *line = buf + (to - from) * NOTIFY_IDX_LINE;
+
+                    line[NOTIFY_IDX_LINE - 1] = '\0';
+                    out = xs_list_append(out, line);
+                }
+            }
+        }
+
+        fclose(f);
     }
 
     return out;
@@ -1953,11 +3674,24 @@ void notify_clear(snac *snac)
 {
     xs *spec   = xs_fmt("%s/notify/" "*", snac->basedir);
     xs *lst    = xs_glob(spec, 0, 0);
+    xs *idx    = xs_fmt("%s/notify.idx", snac->basedir);
+    xs *s_fn   = xs_fmt("%s/notify_seen.txt", snac->basedir);
     xs_list *p = lst;
     xs_str *v;
+    FILE *f;
+
+    pthread_mutex_lock(&data_mutex);
 
     while (xs_list_iter(&p, &v))
         unlink(v);
+
+    /* leave an empty index */
+    if ((f = fopen(idx, "w")) != NULL)
+        fclose(f);
+
+    unlink(s_fn);
+
+    pthread_mutex_unlock(&data_mutex);
 }
 
 
@@ -1970,9 +3704,7 @@ static xs_dict *_enqueue_put(const char *fn, xs_dict *msg)
     FILE *f;
 
     if ((f = fopen(tfn, "w")) != NULL) {
-        xs *j = xs_json_dumps_pp(msg, 4);
-
-        fwrite(j, strlen(j), 1, f);
+        xs_json_dump(msg, 4, f);
         fclose(f);
 
         rename(tfn, fn);
@@ -1982,6 +3714,102 @@ static xs_dict *_enqueue_put(const char *fn, xs_dict *msg)
 }
 
 
+/* queue items can have a key, to avoid enqueueing the same job twice:
+   a file named as the md5 of the key and a .key extension, in the same
+   queue directory, holds the file name of the item that has it; it's
+   only read or changed while holding an exclusive lock on it, and the
+   item is always written before claiming the key, so a key never names
+   an item that is not (yet) there */
+
+static xs_str *_queue_key_fn(const char *fn, const char *key)
+/* returns the key file name for a key in the queue of fn */
+{
+    xs *md5 = xs_md5_hex(key, strlen(key));
+    const char *bn = strrchr(fn, '/');
+
+    return xs_fmt("%.*s/%s.key", (int)(bn - fn), fn, md5);
+}
+
+
+static int _queue_key_open(const char *kfn, char *ifn, int size)
+/* opens and locks a key file, reading the item file name it holds */
+{
+    for (;;) {
+        struct stat st1, st2;
+        int fd, n;
+
+        if ((fd = open(kfn, O_RDWR | O_CREAT, 0660)) == -1)
+            return -1;
+
+        flock(fd, LOCK_EX);
+
+        /* it could have been unlinked while waiting for the lock */
+        if (fstat(fd, &st1) == -1 || stat(kfn, &st2) == -1 ||
+            st1.st_ino != st2.st_ino || st1.st_dev != st2.st_dev) {
+            close(fd);
+            continue;
+        }
+
+        if ((n = read(fd, ifn, size - 1)) < 0)
+            n = 0;
+
+        ifn[n] = '\0';
+        ifn[strcspn(ifn, "\n")] = '\0';
+
+        return fd;
+    }
+}
+
+
+static int _enqueue_key(const char *fn, const char *key)
+/* sets the key for the (already written) item in fn;
+   returns 0 if another queued item has it */
+{
+    xs *kfn = _queue_key_fn(fn, key);
+    char ifn[1024];
+    int fd, ret = 1;
+
+    if ((fd = _queue_key_open(kfn, ifn, sizeof(ifn))) == -1)
+        return 1;
+
+    /* another item still there? */
+    if (*ifn && strcmp(ifn, fn) != 0 && mtime(ifn) != 0.0)
+        ret = 0;
+    else {
+        /* no (or it's stale): claim it */
+        xs *l = xs_fmt("%s\n", fn);
+
+        if (ftruncate(fd, 0) == -1 || pwrite(fd, l, strlen(l), 0) == -1)
+            srv_debug(1, xs_fmt("cannot write key file %s", kfn));
+    }
+
+    close(fd);
+
+    return ret;
+}
+
+
+static void _dequeue_key(const char *fn, const char *key)
+/* clears the key of the item in fn */
+{
+    xs *kfn = _queue_key_fn(fn, key);
+    char ifn[1024];
+    int fd;
+
+    if (mtime(kfn) == 0.0)
+        return;
+
+    if ((fd = _queue_key_open(kfn, ifn, sizeof(ifn))) == -1)
+        return;
+
+    /* only if it's still this item's (or nobody's) */
+    if (*ifn == '\0' || strcmp(ifn, fn) == 0)
+        unlink(kfn);
+
+    close(fd);
+}
+
+
 static xs_dict *_new_qmsg(const char *type, const xs_val *msg, int retries)
 /* creates a queue message */
 {
@@ -2123,35 +3951,25 @@ void enqueue_close_question(snac *user, const char *id, int end_secs)
 void enqueue_request_replies(snac *user, const char *id)
 /* enqueues a request for the replies of a message */
 {
-    /* test first if this precise request is already in the queue */
-    xs *queue = user_queue(user);
-    xs_list *p = queue;
-    xs_str *v;
-
-    while (xs_list_iter(&p, &v)) {
-        xs *q_item = queue_get(v);
-
-        if (q_item != NULL) {
-            const char *type = xs_dict_get(q_item, "type");
-            const char *msg  = xs_dict_get(q_item, "message");
-
-            if (type && msg && strcmp(type, "request_replies") == 0 && strcmp(msg, id) == 0) {
-                /* don't requeue */
-                snac_debug(user, 1, xs_fmt("enqueue_request_replies already here %s", id));
-                return;
-            }
-        }
-    }
-
-    /* not there; enqueue the request with a small delay */
     xs *qmsg = _new_qmsg("request_replies", id, 0);
     xs *ntid = tid(10);
     xs *fn   = xs_fmt("%s/queue/%s.json", user->basedir, ntid);
+    xs *key  = xs_fmt("request_replies %s", id);
 
+    /* enqueue the request with a small delay */
     qmsg = xs_dict_set(qmsg, "ntid", ntid);
+    qmsg = xs_dict_append(qmsg, "key", key);
 
     qmsg = _enqueue_put(fn, qmsg);
 
+    /* if this precise request is already in the queue, take it back
+       (it's not due yet, so no queue thread can have taken it) */
+    if (!_enqueue_key(fn, key)) {
+        unlink(fn);
+        snac_debug(user, 1, xs_fmt("enqueue_request_replies already here %s", id));
+        return;
+    }
+
     snac_debug(user, 1, xs_fmt("enqueue_request_replies %s", id));
 }
 
@@ -2261,9 +4079,15 @@ xs_dict *dequeue(const char *fn)
 {
     xs_dict *obj = queue_get(fn);
 
-    if (obj != NULL)
+    if (obj != NULL) {
+        const char *key = xs_dict_get(obj, "key");
+
         unlink(fn);
 
+        if (!xs_is_null(key))
+            _dequeue_key(fn, key);
+    }
+
     return obj;
 }
 
@@ -2370,7 +4194,7 @@ void purge_server(void)
                         *ext = '\0';
                         o = xs_str_cat(o, ".json");
 
-                        if (mtime(o) == 0.0) {
+                        if (mtime(o) == 0.0 && !_object_thread_alive(v2)) {
                             /* delete */
                             unlink(v2);
                             srv_debug(1, xs_fmt("purged %s", v2));
@@ -2382,9 +4206,8 @@ void purge_server(void)
         }
     }
 
-    /* purge collected inboxes */
-    xs *ib_dir = xs_fmt("%s/inbox", srv_basedir);
-    _purge_dir(ib_dir, 7);
+    /* drop the collected inboxes not seen for a while */
+    inbox_flush(1);
 
     /* purge the instance timeline */
     xs *itl_fn = xs_fmt("%s/public.idx", srv_basedir);
@@ -2394,6 +4217,35 @@ void purge_server(void)
 }
 
 
+static void _purge_queue_keys(const char *qdir)
+/* purges the keys of items no longer in a queue */
+{
+    xs *spec = xs_fmt("%s/" "*.key", qdir);
+    xs *list = xs_glob(spec, 0, 0);
+    xs_list *p;
+    xs_str *v;
+    int cnt = 0;
+
+    p = list;
+    while (xs_list_iter(&p, &v)) {
+        char ifn[1024];
+        int fd;
+
+        if ((fd = _queue_key_open(v, ifn, sizeof(ifn))) == -1)
+            continue;
+
+        if (*ifn == '\0' || mtime(ifn) == 0.0) {
+            unlink(v);
+            cnt++;
+        }
+
+        close(fd);
+    }
+
+    srv_debug(1, xs_fmt("purge: %s keys %d", qdir, cnt));
+}
+
+
 void purge_user(snac *snac)
 /* do the purge for this user */
 {
@@ -2429,6 +4281,13 @@ void purge_user(snac *snac)
         int gc = index_gc(idx);
         srv_debug(1, xs_fmt("purge: %s %d", idx, gc));
     }
+
+    /* compact the top level indexes */
+    _timeline_top_compact(snac, "private");
+    _timeline_top_compact(snac, "public");
+
+    xs *qdir = xs_fmt("%s/queue", snac->basedir);
+    _purge_queue_keys(qdir);
 }
 
 
@@ -2457,15 +4316,68 @@ void purge_all(void)
 
 /** archive **/
 
-void srv_archive(const char *direction, const char *url, xs_dict *req,
-                 const char *payload, int p_size,
-                 int status, xs_dict *headers,
-                 const char *body, int b_size)
-/* archives a connection */
+/* the archive is written by a background thread (if running) from a
+   bounded fifo of exchanges, so request threads don't pay for it */
+
+static pthread_mutex_t archive_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t archive_cond   = PTHREAD_COND_INITIALIZER;
+static pthread_t archive_thread;
+static xs_list *archive_fifo = NULL;
+static int archive_pending   = 0;
+static int archive_running   = 0;
+static unsigned int archive_cnt = 0;
+
+#ifndef ARCHIVE_MAX_PENDING
+#define ARCHIVE_MAX_PENDING 1024
+#endif
+
+/* entries bigger than this are not queued, to bound the memory held by
+   the pending ones (1024 of them could be many megabytes each) */
+#ifndef ARCHIVE_MAX_QUEUED_SIZE
+#define ARCHIVE_MAX_QUEUED_SIZE 0x800000
+#endif
+
+static void _archive_json_file(const char *fn, const char *data, int size)
+/* writes a JSON file, pretty-printed if possible */
+{
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        xs *v1 = xs_json_loads(data);
+
+        if (!xs_json_dump(v1, 4, f))
+            fwrite(data, size, 1, f);
+
+        fclose(f);
+    }
+}
+
+
+static void _archive_raw_file(const char *fn, const char *data, int size)
+/* writes a raw file */
+{
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        fwrite(data, size, 1, f);
+        fclose(f);
+    }
+}
+
+
+static void _srv_archive_write(const xs_dict *entry)
+/* writes an archived connection to disk */
 {
-    /* obsessive archiving */
-    xs *date = tid(0);
-    xs *dir  = xs_fmt("%s/archive/%s_%s", srv_basedir, date, direction);
+    const char *direction = xs_dict_get(entry, "direction");
+    const char *url       = xs_dict_get(entry, "url");
+    const xs_dict *req    = xs_dict_get(entry, "req");
+    const xs_dict *headers = xs_dict_get(entry, "headers");
+    const xs_data *xp     = xs_dict_get(entry, "payload");
+    const xs_data *xb     = xs_dict_get(entry, "body");
+    int p_size = xs_number_get(xs_dict_get(entry, "p_size"));
+    int b_size = xs_number_get(xs_dict_get(entry, "b_size"));
+    xs *dir = xs_fmt("%s/archive/%s_%s", srv_basedir,
+                    xs_dict_get(entry, "date"), direction);
     FILE *f;
 
     if (mkdirx(dir) != -1) {
@@ -2477,80 +4389,217 @@ void srv_archive(const char *direction, const char *url, xs_dict *req,
 
             fprintf(f, "dir: %s\n", direction);
 
-            if (url)
+            if (!xs_is_null(url))
                 fprintf(f, "url: %s\n", url);
 
             fprintf(f, "req: %s\n", j1);
             fprintf(f, "p_size: %d\n", p_size);
-            fprintf(f, "status: %d\n", status);
+            fprintf(f, "status: %d\n", (int)xs_number_get(xs_dict_get(entry, "status")));
             fprintf(f, "response: %s\n", j2);
             fprintf(f, "b_size: %d\n", b_size);
             fclose(f);
         }
 
-        if (p_size && payload) {
-            xs *payload_fn = NULL;
-            xs *payload_fn_raw = NULL;
+        if (xp != NULL) {
+            xs *payload = xs_realloc(NULL, p_size + 1);
             char *v = xs_dict_get(req, "content-type");
 
+            xs_data_get(xp, payload);
+            payload[p_size] = '\0';
+
             if (v && xs_str_in(v, "json") != -1) {
-                payload_fn = xs_fmt("%s/payload.json", dir);
+                xs *payload_fn = xs_fmt("%s/payload.json", dir);
+                _archive_json_file(payload_fn, payload, p_size);
+            }
 
-                if ((f = fopen(payload_fn, "w")) != NULL) {
-                    xs *v1 = xs_json_loads(payload);
-                    xs *j1 = NULL;
+            xs *payload_fn_raw = xs_fmt("%s/payload", dir);
+            _archive_raw_file(payload_fn_raw, payload, p_size);
+        }
 
-                    if (v1 != NULL)
-                        j1 = xs_json_dumps_pp(v1, 4);
+        if (xb != NULL) {
+            xs *body = xs_realloc(NULL, b_size + 1);
+            char *v = xs_dict_get(headers, "content-type");
 
-                    if (j1 != NULL)
-                        fwrite(j1, strlen(j1), 1, f);
-                    else
-                        fwrite(payload, p_size, 1, f);
+            xs_data_get(xb, body);
+            body[b_size] = '\0';
 
-                    fclose(f);
-                }
+            if (v && xs_str_in(v, "json") != -1) {
+                xs *body_fn = xs_fmt("%s/body.json", dir);
+                _archive_json_file(body_fn, body, b_size);
+            }
+            else {
+                xs *body_fn = xs_fmt("%s/body", dir);
+                _archive_raw_file(body_fn, body, b_size);
             }
+        }
+    }
+}
 
-            payload_fn_raw = xs_fmt("%s/payload", dir);
 
-            if ((f = fopen(payload_fn_raw, "w")) != NULL) {
-                fwrite(payload, p_size, 1, f);
-                fclose(f);
-            }
+static void *_archive_thread(void *arg)
+/* the archive writer thread */
+{
+    (void)arg;
+
+    pthread_mutex_lock(&archive_mutex);
+
+    while (archive_running || archive_pending) {
+        if (archive_pending == 0) {
+            pthread_cond_wait(&archive_cond, &archive_mutex);
+            continue;
         }
 
-        if (b_size && body) {
-            xs *body_fn = NULL;
-            char *v = xs_dict_get(headers, "content-type");
+        /* take the full batch and write it unlocked */
+        xs *batch = archive_fifo;
+        archive_fifo    = xs_list_new();
+        archive_pending = 0;
 
-            if (v && xs_str_in(v, "json") != -1) {
-                body_fn = xs_fmt("%s/body.json", dir);
+        pthread_mutex_unlock(&archive_mutex);
 
-                if ((f = fopen(body_fn, "w")) != NULL) {
-                    xs *v1 = xs_json_loads(body);
-                    xs *j1 = NULL;
+        xs_list *p = batch;
+        xs_dict *v;
 
-                    if (v1 != NULL)
-                        j1 = xs_json_dumps_pp(v1, 4);
+        while (xs_list_iter(&p, &v))
+            _srv_archive_write(v);
 
-                    if (j1 != NULL)
-                        fwrite(j1, strlen(j1), 1, f);
-                    else
-                        fwrite(body, b_size, 1, f);
+        pthread_mutex_lock(&archive_mutex);
+    }
 
-                    fclose(f);
-                }
-            }
-            else {
-                body_fn = xs_fmt("%s/body", dir);
+    pthread_mutex_unlock(&archive_mutex);
 
-                if ((f = fopen(body_fn, "w")) != NULL) {
-                    fwrite(body, b_size, 1, f);
-                    fclose(f);
-                }
-            }
+    return NULL;
+}
+
+
+void srv_archive_start(void)
+/* starts the archive writer thread */
+{
+    pthread_mutex_lock(&archive_mutex);
+
+    archive_fifo    = xs_list_new();
+    archive_pending = 0;
+    archive_running = 1;
+
+    pthread_mutex_unlock(&archive_mutex);
+
+    pthread_create(&archive_thread, NULL, _archive_thread, NULL);
+}
+
+
+void srv_archive_stop(void)
+/* flushes the pending archive entries and stops the writer thread */
+{
+    pthread_mutex_lock(&archive_mutex);
+
+    if (!archive_running) {
+        pthread_mutex_unlock(&archive_mutex);
+        return;
+    }
+
+    archive_running = 0;
+    pthread_cond_signal(&archive_cond);
+
+    pthread_mutex_unlock(&archive_mutex);
+
+    pthread_join(archive_thread, NULL);
+
+    archive_fifo = xs_free(archive_fifo);
+}
+
+
+static int _srv_archive_wanted(const char *url, const xs_dict *req)
+/* checks the sampling rate and the path filters */
+{
+    const xs_number *rate = xs_dict_get(srv_config, "archive_sample_rate");
+    const xs_list *paths  = xs_dict_get(srv_config, "archive_paths");
+
+    if (xs_type(rate) == XSTYPE_NUMBER && xs_number_get(rate) > 1) {
+        /* archive only one of every rate exchanges */
+        unsigned int n;
+
+        pthread_mutex_lock(&archive_mutex);
+        n = archive_cnt++;
+        pthread_mutex_unlock(&archive_mutex);
+
+        if (n % (unsigned int)xs_number_get(rate) != 0)
+            return 0;
+    }
+
+    if (xs_type(paths) == XSTYPE_LIST && xs_list_len(paths) > 0) {
+        const char *path = url ? url : xs_dict_get(req, "path");
+        xs_list *p = (xs_list *)paths;
+        xs_str *v;
+
+        if (xs_is_null(path))
+            return 0;
+
+        while (xs_list_iter(&p, &v)) {
+            if (xs_type(v) == XSTYPE_STRING && xs_str_in(path, v) != -1)
+                return 1;
+        }
+
+        return 0;
+    }
+
+    return 1;
+}
+
+
+void srv_archive(const char *direction, const char *url, xs_dict *req,
+                 const char *payload, int p_size,
+                 int status, xs_dict *headers,
+                 const char *body, int b_size)
+/* archives a connection */
+{
+    /* obsessive archiving (only if the archive directory exists) */
+    xs *a_dir = xs_fmt("%s/archive", srv_basedir);
+
+    if (mtime(a_dir) == 0.0 || !_srv_archive_wanted(url, req))
+        return;
+
+    xs *entry = xs_dict_new();
+    xs *date  = tid(0);
+    xs *n_st  = xs_number_new(status);
+    xs *n_ps  = xs_number_new(p_size && payload ? p_size : 0);
+    xs *n_bs  = xs_number_new(b_size && body ? b_size : 0);
+
+    entry = xs_dict_append(entry, "direction", direction);
+    entry = xs_dict_append(entry, "date",      date);
+    entry = xs_dict_append(entry, "url",       url ? url : xs_stock_null);
+    entry = xs_dict_append(entry, "req",       req ? req : xs_stock_null);
+    entry = xs_dict_append(entry, "status",    n_st);
+    entry = xs_dict_append(entry, "headers",   headers ? headers : xs_stock_null);
+    entry = xs_dict_append(entry, "p_size",    n_ps);
+    entry = xs_dict_append(entry, "b_size",    n_bs);
+
+    if (p_size && payload) {
+        xs *d = xs_data_new(payload, p_size);
+        entry = xs_dict_append(entry, "payload", d);
+    }
+
+    if (b_size && body) {
+        xs *d = xs_data_new(body, b_size);
+        entry = xs_dict_append(entry, "body", d);
+    }
+
+    pthread_mutex_lock(&archive_mutex);
+
+    /* big exchanges are written synchronously, instead of keeping them in memory */
+    if (archive_running && xs_size(entry) < ARCHIVE_MAX_QUEUED_SIZE) {
+        if (archive_pending < ARCHIVE_MAX_PENDING) {
+            archive_fifo = xs_list_append(archive_fifo, entry);
+            archive_pending++;
+            pthread_cond_signal(&archive_cond);
         }
+        else
+            srv_debug(1, xs_fmt("srv_archive: writer busy, entry dropped"));
+
+        pthread_mutex_unlock(&archive_mutex);
+    }
+    else {
+        /* no writer thread (e.g. command line); write it now */
+        pthread_mutex_unlock(&archive_mutex);
+        _srv_archive_write(entry);
     }
 }
 
@@ -2569,8 +4618,7 @@ void srv_archive_error(const char *prefix, const xs_str *err,
         if (req) {
             fprintf(f, "Request headers:\n");
 
-            xs *j = xs_json_dumps_pp(req, 4);
-            fwrite(j, strlen(j), 1, f);
+            xs_json_dump(req, 4, f);
 
             fprintf(f, "\n");
         }
@@ -2578,11 +4626,7 @@ void srv_archive_error(const char *prefix, const xs_str *err,
         if (data) {
             fprintf(f, "Data:\n");
 
-            if (xs_type(data) == XSTYPE_LIST || xs_type(data) == XSTYPE_DICT) {
-                xs *j = xs_json_dumps_pp(data, 4);
-                fwrite(j, strlen(j), 1, f);
-            }
-            else
+            if (!xs_json_dump(data, 4, f))
                 fprintf(f, "%s", data);
 
             fprintf(f, "\n");
@@ -6,6 +6,7 @@
 #include "xs_json.h"
 #include "xs_regex.h"
 #include "xs_set.h"
+#include "xs_sbuf.h"
 #include "xs_openssl.h"
 #include "xs_time.h"
 #include "xs_mime.h"
@@ -90,11 +91,9 @@ xs_str *actor_name(xs_dict *actor)
 }
 
 
-xs_str *html_actor_icon(xs_str *os, char *actor,
+void html_actor_icon(xs_sbuf *b, char *actor,
     const char *date, const char *udate, const char *url, int priv)
 {
-    xs *s = xs_str_new(NULL);
-
     xs *avatar = NULL;
     char *v;
 
@@ -109,31 +108,23 @@ xs_str *html_actor_icon(xs_str *os, char *actor,
     if (avatar == NULL)
         avatar = xs_fmt("data:image/png;base64, %s", default_avatar_base64());
 
-    {
-        xs *s1 = xs_fmt("<p><img class=\"snac-avatar\" src=\"%s\" alt=\"\" "
-                        "loading=\"lazy\"/>\n", avatar);
-        s = xs_str_cat(s, s1);
-    }
+    xs_sbuf_fmt(b, "<p><img class=\"snac-avatar\" src=\"%s\" alt=\"\" "
+                   "loading=\"lazy\"/>\n", avatar);
 
-    {
-        xs *s1 = xs_fmt("<a href=\"%s\" class=\"p-author h-card snac-author\">%s</a>",
-            xs_dict_get(actor, "id"), name);
-        s = xs_str_cat(s, s1);
-    }
+    xs_sbuf_fmt(b, "<a href=\"%s\" class=\"p-author h-card snac-author\">%s</a>",
+        xs_dict_get(actor, "id"), name);
 
-    if (!xs_is_null(url)) {
-        xs *s1 = xs_fmt(" <a href=\"%s\">»</a>", url);
-        s = xs_str_cat(s, s1);
-    }
+    if (!xs_is_null(url))
+        xs_sbuf_fmt(b, " <a href=\"%s\">»</a>", url);
 
     if (priv)
-        s = xs_str_cat(s, " <span title=\"private\">&#128274;</span>");
+        xs_sbuf_cat(b, " <span title=\"private\">&#128274;</span>");
 
     if (strcmp(xs_dict_get(actor, "type"), "Service") == 0)
-        s = xs_str_cat(s, " <span title=\"bot\">&#129302;</span>");
+        xs_sbuf_cat(b, " <span title=\"bot\">&#129302;</span>");
 
     if (xs_is_null(date)) {
-        s = xs_str_cat(s, "\n&nbsp;\n");
+        xs_sbuf_cat(b, "\n&nbsp;\n");
     }
     else {
         xs *date_label = xs_crop_i(xs_dup(date), 0, 10);
@@ -151,16 +142,13 @@ xs_str *html_actor_icon(xs_str *os, char *actor,
 
         xs *edt = encode_html(date_title);
         xs *edl = encode_html(date_label);
-        xs *s1 = xs_fmt(
+        xs_sbuf_fmt(b,
             "\n<time class=\"dt-published snac-pubdate\" title=\"%s\">%s</time>\n",
                 edt, edl);
-
-        s = xs_str_cat(s, s1);
     }
 
     {
         char *username, *id;
-        xs *s1;
 
         if (xs_is_null(username = xs_dict_get(actor, "preferredUsername")) || *username == '\0') {
             /* This should never be reached */
@@ -177,18 +165,14 @@ xs_str *html_actor_icon(xs_str *os, char *actor,
         xs *user   = xs_fmt("@%s@%s", username, xs_list_get(domain, 2));
 
         xs *u1 = encode_html(user);
-        s1 = xs_fmt(
+        xs_sbuf_fmt(b,
             "<br><a href=\"%s\" class=\"p-author-tag h-card snac-author-tag\">%s</a>",
                 xs_dict_get(actor, "id"), u1);
-
-        s = xs_str_cat(s, s1);
     }
-
-    return xs_str_cat(os, s);
 }
 
 
-xs_str *html_msg_icon(snac *snac, xs_str *os, const xs_dict *msg)
+void html_msg_icon(snac *snac, xs_sbuf *b, const xs_dict *msg)
 {
     char *actor_id;
     xs *actor = NULL;
@@ -211,30 +195,26 @@ xs_str *html_msg_icon(snac *snac, xs_str *os, const xs_dict *msg)
         date  = xs_dict_get(msg, "published");
         udate = xs_dict_get(msg, "updated");
 
-        os = html_actor_icon(os, actor, date, udate, url, priv);
+        html_actor_icon(b, actor, date, udate, url, priv);
     }
-
-    return os;
 }
 
 
-d_char *html_user_header(snac *snac, d_char *s, int local)
+void html_user_header(snac *snac, xs_sbuf *b, int local)
 /* creates the HTML header */
 {
     char *p, *v;
 
-    s = xs_str_cat(s, "<!DOCTYPE html>\n<html>\n<head>\n");
-    s = xs_str_cat(s, "<meta name=\"viewport\" "
-                      "content=\"width=device-width, initial-scale=1\"/>\n");
-    s = xs_str_cat(s, "<meta name=\"generator\" "
-                      "content=\"" USER_AGENT "\"/>\n");
+    xs_sbuf_cat(b, "<!DOCTYPE html>\n<html>\n<head>\n");
+    xs_sbuf_cat(b, "<meta name=\"viewport\" "
+                   "content=\"width=device-width, initial-scale=1\"/>\n");
+    xs_sbuf_cat(b, "<meta name=\"generator\" "
+                   "content=\"" USER_AGENT "\"/>\n");
 
     /* add server CSS */
     p = xs_dict_get(srv_config, "cssurls");
-    while (xs_list_iter(&p, &v)) {
-        xs *s1 = xs_fmt("<link rel=\"stylesheet\" type=\"text/css\" href=\"%s\"/>\n", v);
-        s = xs_str_cat(s, s1);
-    }
+    while (xs_list_iter(&p, &v))
+        xs_sbuf_fmt(b, "<link rel=\"stylesheet\" type=\"text/css\" href=\"%s\"/>\n", v);
 
     /* add the user CSS */
     {
@@ -253,19 +233,16 @@ d_char *html_user_header(snac *snac, d_char *s, int local)
             }
         }
 
-        if (css != NULL) {
-            xs *s1 = xs_fmt("<style>%s</style>\n", css);
-            s = xs_str_cat(s, s1);
-        }
+        if (css != NULL)
+            xs_sbuf_fmt(b, "<style>%s</style>\n", css);
     }
 
     {
         xs *es1 = encode_html(xs_dict_get(snac->config, "name"));
         xs *es2 = encode_html(snac->uid);
         xs *es3 = encode_html(xs_dict_get(srv_config,   "host"));
-        xs *s1 = xs_fmt("<title>%s (@%s@%s)</title>\n", es1, es2, es3);
 
-        s = xs_str_cat(s, s1);
+        xs_sbuf_fmt(b, "<title>%s (@%s@%s)</title>\n", es1, es2, es3);
     }
 
     xs *avatar = xs_dup(xs_dict_get(snac->config, "avatar"));
@@ -300,7 +277,7 @@ d_char *html_user_header(snac *snac, d_char *s, int local)
         xs *es5 = encode_html(s_bio);
         xs *es6 = encode_html(s_avatar);
 
-        xs *s1 = xs_fmt(
+        xs_sbuf_fmt(b,
             "<meta property=\"og:site_name\" content=\"%s\"/>\n"
             "<meta property=\"og:title\" content=\"%s (@%s@%s)\"/>\n"
             "<meta property=\"og:description\" content=\"%s\"/>\n"
@@ -308,40 +285,27 @@ d_char *html_user_header(snac *snac, d_char *s, int local)
             "<meta property=\"og:image:width\" content=\"300\"/>\n"
             "<meta property=\"og:image:height\" content=\"300\"/>\n",
             es1, es2, es3, es4, es5, es6);
-        s = xs_str_cat(s, s1);
     }
 
-    {
-        xs *s1 = xs_fmt("<link rel=\"alternate\" type=\"application/rss+xml\" "
-                        "title=\"RSS\" href=\"%s.rss\" />\n", snac->actor); /* snac->actor is likely need to be URLEncoded. */
-        s = xs_str_cat(s, s1);
-    }
+    xs_sbuf_fmt(b, "<link rel=\"alternate\" type=\"application/rss+xml\" "
+                   "title=\"RSS\" href=\"%s.rss\" />\n", snac->actor); /* snac->actor is likely need to be URLEncoded. */
 
-    s = xs_str_cat(s, "</head>\n<body>\n");
+    xs_sbuf_cat(b, "</head>\n<body>\n");
 
     /* top nav */
-    s = xs_str_cat(s, "<nav class=\"snac-top-nav\">");
-
-    {
-        xs *s1;
-
-        s1 = xs_fmt("<img src=\"%s\" class=\"snac-avatar\" alt=\"\"/>&nbsp;", avatar);
+    xs_sbuf_cat(b, "<nav class=\"snac-top-nav\">");
 
-        s = xs_str_cat(s, s1);
-    }
+    xs_sbuf_fmt(b, "<img src=\"%s\" class=\"snac-avatar\" alt=\"\"/>&nbsp;", avatar);
 
     {
-        xs *s1;
-
         if (local)
-            s1 = xs_fmt(
+            xs_sbuf_fmt(b,
                 "<a href=\"%s.rss\">%s</a> - "
                 "<a href=\"%s/admin\" rel=\"nofollow\">%s</a></nav>\n",
                 snac->actor, L("RSS"),
                 snac->actor, L("private"));
         else {
-            xs *n_list = notify_list(snac, 1);
-            int n_len  = xs_list_len(n_list);
+            int n_len  = notify_new_len(snac);
             xs *n_str  = NULL;
 
             /* show the number of new notifications, if there are any */
@@ -351,7 +315,7 @@ d_char *html_user_header(snac *snac, d_char *s, int local)
             else
                 n_str = xs_str_new("");
 
-            s1 = xs_fmt(
+            xs_sbuf_fmt(b,
                 "<a href=\"%s\">%s</a> - "
                 "<a href=\"%s/admin\">%s</a> - "
                 "<a href=\"%s/notifications\">%s</a>%s - "
@@ -361,8 +325,6 @@ d_char *html_user_header(snac *snac, d_char *s, int local)
                 snac->actor, L("notifications"), n_str,
                 snac->actor, L("people"));
         }
-
-        s = xs_str_cat(s, s1);
     }
 
     /* user info */
@@ -376,28 +338,23 @@ d_char *html_user_header(snac *snac, d_char *s, int local)
         xs *es2 = encode_html(xs_dict_get(snac->config, "uid"));
         xs *es3 = encode_html(xs_dict_get(srv_config, "host"));
 
-        xs *s1 = xs_fmt(_tmpl, es1, es2, es3);
-
-        s = xs_str_cat(s, s1);
+        xs_sbuf_fmt(b, _tmpl, es1, es2, es3);
 
         if (local) {
             xs *es1  = encode_html(xs_dict_get(snac->config, "bio"));
             xs *bio1 = not_really_markdown(es1, NULL);
             xs *tags = xs_list_new();
             xs *bio2 = process_tags(snac, bio1, &tags);
-            xs *s1   = xs_fmt("<div class=\"p-note snac-top-user-bio\">%s</div>\n", bio2);
 
-            s = xs_str_cat(s, s1);
+            xs_sbuf_fmt(b, "<div class=\"p-note snac-top-user-bio\">%s</div>\n", bio2);
         }
 
-        s = xs_str_cat(s, "</div>\n");
+        xs_sbuf_cat(b, "</div>\n");
     }
-
-    return s;
 }
 
 
-d_char *html_top_controls(snac *snac, d_char *s)
+void html_top_controls(snac *snac, xs_sbuf *b)
 /* generates the top controls */
 {
     char *_tmpl =
@@ -524,11 +481,11 @@ d_char *html_top_controls(snac *snac, d_char *s)
     if (xs_is_null(telegram_chat_id))
         telegram_chat_id = "";
 
+    char purge_days_s[64] = "0";
     const char *purge_days = xs_dict_get(snac->config, "purge_days");
     if (!xs_is_null(purge_days) && xs_type(purge_days) == XSTYPE_NUMBER)
-        purge_days = xs_number_str(purge_days);
-    else
-        purge_days = "0";
+        xs_number_fmt(purge_days, purge_days_s, sizeof(purge_days_s));
+    purge_days = purge_days_s;
 
     const char *d_dm_f_u = xs_dict_get(snac->config, "drop_dm_from_unknown");
 
@@ -541,7 +498,7 @@ d_char *html_top_controls(snac *snac, d_char *s)
     xs *es5 = encode_html(telegram_chat_id);
     xs *es6 = encode_html(purge_days);
 
-    xs *s1 = xs_fmt(_tmpl,
+    xs_sbuf_fmt(b, _tmpl,
         L("New Post..."),
         snac->actor,
         L("Sensitive content"),
@@ -594,21 +551,15 @@ d_char *html_top_controls(snac *snac, d_char *s)
         L("Repeat new password"),
         L("Update user info")
     );
-
-    s = xs_str_cat(s, s1);
-
-    return s;
 }
 
 
-d_char *html_button(d_char *s, char *clss, char *label)
+void html_button(xs_sbuf *b, char *clss, char *label)
 {
-    xs *s1 = xs_fmt(
+    xs_sbuf_fmt(b,
                "<input type=\"submit\" name=\"action\" "
                "class=\"snac-btn-%s\" value=\"%s\">\n",
                 clss, label);
-
-    return xs_str_cat(s, s1);
 }
 
 
@@ -662,67 +613,61 @@ xs_str *build_mentions(snac *snac, const xs_dict *msg)
 }
 
 
-xs_str *html_entry_controls(snac *snac, xs_str *os, const xs_dict *msg, const char *md5)
+void html_entry_controls(snac *snac, xs_sbuf *b, const xs_dict *msg, const char *md5)
 {
     char *id    = xs_dict_get(msg, "id");
     char *actor = xs_dict_get(msg, "attributedTo");
     xs *likes   = object_likes(id);
     xs *boosts  = object_announces(id);
 
-    xs *s   = xs_str_new(NULL);
+    xs_sbuf_cat(b, "<div class=\"snac-controls\">\n");
 
-    s = xs_str_cat(s, "<div class=\"snac-controls\">\n");
+    xs_sbuf_fmt(b,
+        "<form autocomplete=\"off\" method=\"post\" action=\"%s/admin/action\">\n"
+        "<input type=\"hidden\" name=\"id\" value=\"%s\">\n"
+        "<input type=\"hidden\" name=\"actor\" value=\"%s\">\n"
+        "<input type=\"hidden\" name=\"redir\" value=\"%s_entry\">\n"
+        "\n",
 
-    {
-        xs *s1 = xs_fmt(
-            "<form autocomplete=\"off\" method=\"post\" action=\"%s/admin/action\">\n"
-            "<input type=\"hidden\" name=\"id\" value=\"%s\">\n"
-            "<input type=\"hidden\" name=\"actor\" value=\"%s\">\n"
-            "<input type=\"hidden\" name=\"redir\" value=\"%s_entry\">\n"
-            "\n",
-
-            snac->actor, id, actor, md5
-        );
-
-        s = xs_str_cat(s, s1);
-    }
+        snac->actor, id, actor, md5
+    );
 
     if (!xs_startswith(id, snac->actor)) {
         if (xs_list_in(likes, snac->md5) == -1) {
             /* not already liked; add button */
-            s = html_button(s, "like", L("Like"));
+            html_button(b, "like", L("Like"));
         }
     }
     else {
         if (is_pinned(snac, id))
-            s = html_button(s, "unpin", L("Unpin"));
+            html_button(b, "unpin", L("Unpin"));
         else
-            s = html_button(s, "pin", L("Pin"));
+            html_button(b, "pin", L("Pin"));
     }
 
     if (is_msg_public(snac, msg)) {
         if (strcmp(actor, snac->actor) == 0 || xs_list_in(boosts, snac->md5) == -1) {
             /* not already boosted or us; add button */
-            s = html_button(s, "boost", L("Boost"));
+            html_button(b, "boost", L("Boost"));
         }
     }
 
     if (strcmp(actor, snac->actor) != 0) {
         /* controls for other actors than this one */
         if (following_check(snac, actor)) {
-            s = html_button(s, "unfollow", L("Unfollow"));
+            html_button(b, "unfollow", L("Unfollow"));
         }
         else {
-            s = html_button(s, "follow", L("Follow"));
+            html_button(b, "follow", L("Follow"));
         }
 
-        s = html_button(s, "mute", L("MUTE"));
+        html_button(b, "mute", L("MUTE"));
     }
 
-    s = html_button(s, "delete", L("Delete"));
-    s = html_button(s, "hide",   L("Hide"));
+    html_button(b, "delete", L("Delete"));
+    html_button(b, "hide",   L("Hide"));
 
-    s = xs_str_cat(s, "</form>\n");
+    xs_sbuf_cat(b, "</form>\n");
 
     const char *prev_src1 = xs_dict_get(msg, "sourceContent");
 
@@ -732,7 +677,7 @@ xs_str *html_entry_controls(snac *snac, xs_str *os, const xs_dict *msg, const ch
         const char *summary = xs_dict_get(msg, "summary");
 
         /* post can be edited */
-        xs *s1 = xs_fmt(
+        xs_sbuf_fmt(b,
             "<p><details><summary>%s</summary>\n"
             "<p><div class=\"snac-note\" id=\"%s_edit\">\n"
             "<form autocomplete=\"off\" method=\"post\" action=\"%s/admin/note\" "
@@ -772,8 +717,6 @@ xs_str *html_entry_controls(snac *snac, xs_str *os, const xs_dict *msg, const ch
             md5,
             L("Post")
         );
-
-        s = xs_str_cat(s, s1);
     }
 
     { /** reply **/
@@ -783,7 +726,7 @@ xs_str *html_entry_controls(snac *snac, xs_str *os, const xs_dict *msg, const ch
         const xs_val *sensitive = xs_dict_get(msg, "sensitive");
         const char *summary = xs_dict_get(msg, "summary");
 
-        xs *s1 = xs_fmt(
+        xs_sbuf_fmt(b,
             "<p><details><summary>%s</summary>\n"
             "<p><div class=\"snac-note\" id=\"%s_reply\">\n"
             "<form autocomplete=\"off\" method=\"post\" action=\"%s/admin/note\" "
@@ -823,18 +766,15 @@ xs_str *html_entry_controls(snac *snac, xs_str *os, const xs_dict *msg, const ch
             md5,
             L("Post")
         );
-
-        s = xs_str_cat(s, s1);
     }
 
-    s = xs_str_cat(s, "</div>\n");
-
-    return xs_str_cat(os, s);
+    xs_sbuf_cat(b, "</div>\n");
 }
 
 
-xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
-                   int level, const char *md5, int hide_children)
+void html_entry(snac *snac, xs_sbuf *b, const xs_dict *msg, int local,
+                int level, const char *md5, int hide_children, const xs_dict *thread)
+/* adds an entry and its replies; thread is its conversation (or NULL) */
 {
     char *id    = xs_dict_get(msg, "id");
     char *type  = xs_dict_get(msg, "type");
@@ -845,79 +785,75 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
 
     /* do not show non-public messages in the public timeline */
     if (local && !is_msg_public(snac, msg))
-        return os;
+        return;
 
     /* hidden? do nothing more for this conversation */
     if (is_hidden(snac, id))
-        return os;
+        return;
 
     /* avoid too deep nesting, as it may be a loop */
     if (level >= 256)
-        return os;
-
-    xs *s = xs_str_new("<div>\n");
-
-    {
-        xs *s1 = xs_fmt("<a name=\"%s_entry\"></a>\n", md5);
-
-        s = xs_str_cat(s, s1);
-    }
+        return;
 
     if (strcmp(type, "Follow") == 0) {
-        s = xs_str_cat(s, "<div class=\"snac-post\">\n<div class=\"snac-post-header\">\n");
+        xs_sbuf_fmt(b, "<div>\n<a name=\"%s_entry\"></a>\n", md5);
+
+        xs_sbuf_cat(b, "<div class=\"snac-post\">\n<div class=\"snac-post-header\">\n");
 
-        xs *s1 = xs_fmt("<div class=\"snac-origin\">%s</div>\n", L("follows you"));
-        s = xs_str_cat(s, s1);
+        xs_sbuf_fmt(b, "<div class=\"snac-origin\">%s</div>\n", L("follows you"));
 
-        s = html_msg_icon(snac, s, msg);
+        html_msg_icon(snac, b, msg);
 
-        s = xs_str_cat(s, "</div>\n</div>\n");
+        xs_sbuf_cat(b, "</div>\n</div>\n");
 
-        return xs_str_cat(os, s);
+        return;
     }
     else
     if (strcmp(type, "Note") != 0 && strcmp(type, "Question") != 0 && strcmp(type, "Page") != 0) {
         /* skip oddities */
-        return os;
+        return;
     }
 
     /* ignore notes with "name", as they are votes to Questions */
     if (strcmp(type, "Note") == 0 && !xs_is_null(xs_dict_get(msg, "name")))
-        return os;
+        return;
 
     /* bring the main actor */
     if ((actor = xs_dict_get(msg, "attributedTo")) == NULL)
-        return os;
+        return;
 
     /* ignore muted morons immediately */
     if (is_muted(snac, actor))
-        return os;
+        return;
 
     if (strcmp(actor, snac->actor) != 0 && !valid_status(actor_get(snac, actor, NULL)))
-        return os;
+        return;
+
+    xs_sbuf_fmt(b, "<div>\n<a name=\"%s_entry\"></a>\n", md5);
+
+    /* many lookups into msg follow */
+    xs_dict_idx mi;
+    xs_dict_idx_init(&mi, msg);
 
     if (level == 0)
-        s = xs_str_cat(s, "<div class=\"snac-post\">\n"); /** **/
+        xs_sbuf_cat(b, "<div class=\"snac-post\">\n"); /** **/
     else
-        s = xs_str_cat(s, "<div class=\"snac-child\">\n"); /** **/
+        xs_sbuf_cat(b, "<div class=\"snac-child\">\n"); /** **/
 
-    s = xs_str_cat(s, "<div class=\"snac-post-header\">\n<div class=\"snac-score\">"); /** **/
+    xs_sbuf_cat(b, "<div class=\"snac-post-header\">\n<div class=\"snac-score\">"); /** **/
 
     if (is_pinned(snac, id)) {
         /* add a pin emoji */
-        xs *f = xs_fmt("<span title=\"%s\"> &#128204; </span>", L("Pinned"));
-        s = xs_str_cat(s, f);
+        xs_sbuf_fmt(b, "<span title=\"%s\"> &#128204; </span>", L("Pinned"));
     }
 
     if (strcmp(type, "Question") == 0) {
         /* add the ballot box emoji */
-        xs *f = xs_fmt("<span title=\"%s\"> &#128499; </span>", L("Poll"));
-        s = xs_str_cat(s, f);
+        xs_sbuf_fmt(b, "<span title=\"%s\"> &#128499; </span>", L("Poll"));
 
         if (was_question_voted(snac, id)) {
             /* add a check to show this poll was voted */
-            xs *f2 = xs_fmt("<span title=\"%s\"> &#10003; </span>", L("Voted"));
-            s = xs_str_cat(s, f2);
+            xs_sbuf_fmt(b, "<span title=\"%s\"> &#10003; </span>", L("Voted"));
         }
     }
 
@@ -928,12 +864,10 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
 
         /* alternate emojis: %d &#128077; %d &#128257; */
 
-        xs *s1 = xs_fmt("%d &#9733; %d &#8634;\n", n_likes, n_boosts);
-
-        s = xs_str_cat(s, s1);
+        xs_sbuf_fmt(b, "%d &#9733; %d &#8634;\n", n_likes, n_boosts);
     }
 
-    s = xs_str_cat(s, "</div>\n");
+    xs_sbuf_cat(b, "</div>\n");
 
     if (boosts == NULL)
         boosts = object_announces(id);
@@ -946,28 +880,24 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
         if (xs_list_in(boosts, snac->md5) != -1) {
             /* we boosted this */
             xs *es1 = encode_html(xs_dict_get(snac->config, "name"));
-            xs *s1 = xs_fmt(
+            xs_sbuf_fmt(b,
                 "<div class=\"snac-origin\">"
                 "<a href=\"%s\">%s</a> %s</a></div>",
                 snac->actor, es1, L("boosted")
             );
-
-            s = xs_str_cat(s, s1);
         }
         else
         if (valid_status(object_get_by_md5(p, &actor_r))) {
             xs *name = actor_name(actor_r);
 
             if (!xs_is_null(name)) {
-                xs *s1 = xs_fmt(
+                xs_sbuf_fmt(b,
                     "<div class=\"snac-origin\">"
                     "<a href=\"%s\">%s</a> %s</div>\n",
                     xs_dict_get(actor_r, "id"),
                     name,
                     L("boosted")
                 );
-
-                s = xs_str_cat(s, s1);
             }
         }
     }
@@ -975,55 +905,52 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
     if (strcmp(type, "Note") == 0) {
         if (level == 0) {
             /* is the parent not here? */
-            char *parent = xs_dict_get(msg, "inReplyTo");
+            char *parent = xs_dict_idx_get(&mi, "inReplyTo");
 
             if (!xs_is_null(parent) && *parent && !timeline_here(snac, parent)) {
-                xs *s1 = xs_fmt(
+                xs_sbuf_fmt(b,
                     "<div class=\"snac-origin\">%s "
                     "<a href=\"%s\">»</a></div>\n",
                     L("in reply to"), parent
                 );
-
-                s = xs_str_cat(s, s1);
             }
         }
     }
 
-    s = html_msg_icon(snac, s, msg);
+    html_msg_icon(snac, b, msg);
 
     /* add the content */
-    s = xs_str_cat(s, "</div>\n<div class=\"e-content snac-content\">\n"); /** **/
+    xs_sbuf_cat(b, "</div>\n<div class=\"e-content snac-content\">\n"); /** **/
 
-    if (!xs_is_null(v = xs_dict_get(msg, "name"))) {
+    if (!xs_is_null(v = xs_dict_idx_get(&mi, "name"))) {
         xs *es1 = encode_html(v);
-        xs *s1  = xs_fmt("<h3 class=\"snac-entry-title\">%s</h3>\n", es1);
-        s = xs_str_cat(s, s1);
+
+        xs_sbuf_fmt(b, "<h3 class=\"snac-entry-title\">%s</h3>\n", es1);
     }
 
     /* is it sensitive? */
-    if (!xs_is_null(v = xs_dict_get(msg, "sensitive")) && xs_type(v) == XSTYPE_TRUE) {
-        if (xs_is_null(v = xs_dict_get(msg, "summary")) || *v == '\0')
+    if (!xs_is_null(v = xs_dict_idx_get(&mi, "sensitive")) && xs_type(v) == XSTYPE_TRUE) {
+        if (xs_is_null(v = xs_dict_idx_get(&mi, "summary")) || *v == '\0')
             v = "...";
         /* only show it when not in the public timeline and the config setting is "open" */
         char *cw = xs_dict_get(snac->config, "cw");
         if (xs_is_null(cw) || local)
             cw = "";
         xs *es1 = encode_html(v);
-        xs *s1 = xs_fmt("<details %s><summary>%s [%s]</summary>\n", cw, es1, L("SENSITIVE CONTENT"));
-        s = xs_str_cat(s, s1);
+
+        xs_sbuf_fmt(b, "<details %s><summary>%s [%s]</summary>\n", cw, es1, L("SENSITIVE CONTENT"));
         sensitive = 1;
     }
 
 #if 0
     {
         xs *md5 = xs_md5_hex(id, strlen(id));
-        xs *s1  = xs_fmt("<p><code>%s</code></p>\n", md5);
-        s = xs_str_cat(s, s1);
+        xs_sbuf_fmt(b, "<p><code>%s</code></p>\n", md5);
     }
 #endif
 
     {
-        const char *content = xs_dict_get(msg, "content");
+        const char *content = xs_dict_idx_get(&mi, "content");
 
         xs *c  = sanitize(xs_is_null(content) ? "" : content);
         char *p, *v;
@@ -1042,7 +969,7 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
         }
 
         /* replace the :shortnames: */
-        if (!xs_is_null(p = xs_dict_get(msg, "tag"))) {
+        if (!xs_is_null(p = xs_dict_idx_get(&mi, "tag"))) {
             xs *tag = NULL;
             if (xs_type(p) == XSTYPE_DICT) {
                 /* not a list */
@@ -1074,14 +1001,16 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
             }
         }
 
+        xs_sbuf_cat(b, c);
+
         if (strcmp(type, "Question") == 0) { /** question content **/
-            xs_list *oo = xs_dict_get(msg, "oneOf");
-            xs_list *ao = xs_dict_get(msg, "anyOf");
+            xs_list *oo = xs_dict_idx_get(&mi, "oneOf");
+            xs_list *ao = xs_dict_idx_get(&mi, "anyOf");
             xs_list *p;
             xs_dict *v;
             int closed = 0;
 
-            if (xs_dict_get(msg, "closed"))
+            if (xs_dict_idx_get(&mi, "closed"))
                 closed = 2;
             else
             if (xs_startswith(id, snac->actor))
@@ -1095,7 +1024,7 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
 
             if (closed) {
                 /* closed poll */
-                c = xs_str_cat(c, "<table class=\"snac-poll-result\">\n");
+                xs_sbuf_cat(b, "<table class=\"snac-poll-result\">\n");
 
                 while (xs_list_iter(&p, &v)) {
                     const char *name       = xs_dict_get(v, "name");
@@ -1104,21 +1033,20 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
                     if (name && replies) {
                         int nr = xs_number_get(xs_dict_get(replies, "totalItems"));
                         xs *es1 = encode_html(name);
-                        xs *l = xs_fmt("<tr><td>%s:</td><td>%d</td></tr>\n", es1, nr);
 
-                        c = xs_str_cat(c, l);
+                        xs_sbuf_fmt(b, "<tr><td>%s:</td><td>%d</td></tr>\n", es1, nr);
                     }
                 }
 
-                c = xs_str_cat(c, "</table>\n");
+                xs_sbuf_cat(b, "</table>\n");
             }
             else {
                 /* poll still active */
-                xs *s1 = xs_fmt("<div class=\"snac-poll-form\">\n"
-                                "<form autocomplete=\"off\" "
-                                "method=\"post\" action=\"%s/admin/vote\">\n"
-                                "<input type=\"hidden\" name=\"actor\" value= \"%s\">\n"
-                                "<input type=\"hidden\" name=\"irt\" value=\"%s\">\n",
+                xs_sbuf_fmt(b, "<div class=\"snac-poll-form\">\n"
+                               "<form autocomplete=\"off\" "
+                               "method=\"post\" action=\"%s/admin/vote\">\n"
+                               "<input type=\"hidden\" name=\"actor\" value= \"%s\">\n"
+                               "<input type=\"hidden\" name=\"irt\" value=\"%s\">\n",
                     snac->actor, actor, id);
 
                 while (xs_list_iter(&p, &v)) {
@@ -1126,31 +1054,24 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
 
                     if (name) {
                         xs *es1 = encode_html(name);
-                        xs *opt = xs_fmt("<input type=\"%s\""
+
+                        xs_sbuf_fmt(b, "<input type=\"%s\""
                                     " id=\"%s\" value=\"%s\" name=\"question\"> %s<br>\n",
                                     !xs_is_null(oo) ? "radio" : "checkbox",
                                     es1, es1, es1);
-
-                        s1 = xs_str_cat(s1, opt);
                     }
                 }
 
-                xs *s2 = xs_fmt("<p><input type=\"submit\" "
-                                "class=\"button\" value=\"%s\">\n</form>\n</div>\n\n", L("Vote"));
-
-                s1 = xs_str_cat(s1, s2);
-
-                c = xs_str_cat(c, s1);
+                xs_sbuf_fmt(b, "<p><input type=\"submit\" "
+                               "class=\"button\" value=\"%s\">\n</form>\n</div>\n\n", L("Vote"));
             }
 
             /* if it's *really* closed, say it */
-            if (closed == 2) {
-                xs *s1 = xs_fmt("<p>%s</p>\n", L("Closed"));
-                c = xs_str_cat(c, s1);
-            }
+            if (closed == 2)
+                xs_sbuf_fmt(b, "<p>%s</p>\n", L("Closed"));
             else {
                 /* show when the poll closes */
-                const char *end_time = xs_dict_get(msg, "endTime");
+                const char *end_time = xs_dict_idx_get(&mi, "endTime");
                 if (!xs_is_null(end_time)) {
                     time_t t0 = time(NULL);
                     time_t t1 = xs_parse_iso_date(end_time, 0);
@@ -1164,20 +1085,18 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
                         for (; *p == '0' || *p == ':'; p++);
 
                         xs *es1 = encode_html(p);
-                        xs *s1 = xs_fmt("<p>%s %s</p>", L("Closes in"), es1);
-                        c = xs_str_cat(c, s1);
+
+                        xs_sbuf_fmt(b, "<p>%s %s</p>", L("Closes in"), es1);
                     }
                 }
             }
         }
-
-        s = xs_str_cat(s, c);
     }
 
-    s = xs_str_cat(s, "\n");
+    xs_sbuf_cat(b, "\n");
 
     /* add the attachments */
-    v = xs_dict_get(msg, "attachment");
+    v = xs_dict_idx_get(&mi, "attachment");
 
     if (!xs_is_null(v)) { /** attachments **/
         xs *attach = NULL;
@@ -1191,13 +1110,13 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
             attach = xs_dup(v);
 
         /* does the message have an image? */
-        if (xs_type(v = xs_dict_get(msg, "image")) == XSTYPE_DICT) {
+        if (xs_type(v = xs_dict_idx_get(&mi, "image")) == XSTYPE_DICT) {
             /* add it to the attachment list */
             attach = xs_list_append(attach, v);
         }
 
         /* make custom css for attachments easier */
-        s = xs_str_cat(s, "<div class=\"snac-content-attachments\">\n");
+        xs_sbuf_cat(b, "<div class=\"snac-content-attachments\">\n");
 
         xs_list *p = attach;
 
@@ -1218,87 +1137,88 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
 
             const char *name = xs_dict_get(v, "name");
             if (xs_is_null(name))
-                name = xs_dict_get(msg, "name");
+                name = xs_dict_idx_get(&mi, "name");
             if (xs_is_null(name))
                 name = L("No description");
 
             xs *es1 = encode_html(name);
-            xs *s1  = NULL;
 
             if (xs_startswith(t, "image/") || strcmp(t, "Image") == 0) {
-                s1 = xs_fmt(
+                xs_sbuf_fmt(b,
                     "<a href=\"%s\" target=\"_blank\">"
                     "<img src=\"%s\" alt=\"%s\" title=\"%s\" loading=\"lazy\"/></a>\n",
                         url, url, es1, es1);
             }
             else
             if (xs_startswith(t, "video/")) {
-                s1 = xs_fmt("<video style=\"width: 100%\" class=\"snac-embedded-video\" "
+                xs_sbuf_fmt(b, "<video style=\"width: 100%\" class=\"snac-embedded-video\" "
                         "controls src=\"%s\">Video: "
                         "<a href=\"%s\">%s</a></video>\n", url, url, es1);
             }
             else
             if (xs_startswith(t, "audio/")) {
-                s1 = xs_fmt("<audio style=\"width: 100%\" class=\"snac-embedded-audio\" "
+                xs_sbuf_fmt(b, "<audio style=\"width: 100%\" class=\"snac-embedded-audio\" "
                         "controls src=\"%s\">Audio: "
                         "<a href=\"%s\">%s</a></audio>\n", url, url, es1);
             }
             else
             if (strcmp(t, "Link") == 0) {
                 xs *es2 = encode_html(url);
-                s1  = xs_fmt("<p><a href=\"%s\">%s</a></p>\n", url, es2);
+                xs_sbuf_fmt(b, "<p><a href=\"%s\">%s</a></p>\n", url, es2);
             }
             else {
-                s1 = xs_fmt("<p><a href=\"%s\">Attachment: %s</a></p>\n", url, es1);
+                xs_sbuf_fmt(b, "<p><a href=\"%s\">Attachment: %s</a></p>\n", url, es1);
             }
-
-            if (!xs_is_null(s1))
-                s = xs_str_cat(s, s1);
         }
 
-        s = xs_str_cat(s, "</div>\n");
+        xs_sbuf_cat(b, "</div>\n");
     }
 
     /* has this message an audience (i.e., comes from a channel or community)? */
-    const char *audience = xs_dict_get(msg, "audience");
+    const char *audience = xs_dict_idx_get(&mi, "audience");
     if (strcmp(type, "Page") == 0 && !xs_is_null(audience)) {
         xs *es1 = encode_html(audience);
-        xs *s1 = xs_fmt("<p>(<a href=\"%s\" title=\"%s\">%s</a>)</p>\n",
+
+        xs_sbuf_fmt(b, "<p>(<a href=\"%s\" title=\"%s\">%s</a>)</p>\n",
             audience, L("Source channel or community"), es1);
-        s = xs_str_cat(s, s1);
     }
 
     if (sensitive)
-        s = xs_str_cat(s, "</details><p>\n");
+        xs_sbuf_cat(b, "</details><p>\n");
 
-    s = xs_str_cat(s, "</div>\n");
+    xs_sbuf_cat(b, "</div>\n");
 
     /** controls **/
 
     if (!local)
-        s = html_entry_controls(snac, s, msg, md5);
+        html_entry_controls(snac, b, msg, md5);
 
     /** children **/
     if (!hide_children) {
-        xs *children = object_children(id);
+        xs *t = NULL;
+
+        /* read the conversation only once for the full thread */
+        if (thread == NULL)
+            thread = t = object_thread(md5);
+
+        xs *children = thread_children(thread, md5);
         int left     = xs_list_len(children);
 
         if (left) {
             char *p, *cmd5;
             int older_open = 0;
-            xs *ss = xs_str_new(NULL);
             int n_children = 0;
+            int pos = b->len;
 
-            ss = xs_str_cat(ss, "<details open><summary>...</summary><p>\n");
+            xs_sbuf_cat(b, "<details open><summary>...</summary><p>\n");
 
             if (level < 4)
-                ss = xs_str_cat(ss, "<div class=\"snac-children\">\n");
+                xs_sbuf_cat(b, "<div class=\"snac-children\">\n");
             else
-                ss = xs_str_cat(ss, "<div>\n");
+                xs_sbuf_cat(b, "<div>\n");
 
             if (left > 3) {
-                xs *s1 = xs_fmt("<details><summary>%s</summary>\n", L("Older..."));
-                ss = xs_str_cat(ss, s1);
+                xs_sbuf_fmt(b, "<details><summary>%s</summary>\n", L("Older..."));
                 older_open = 1;
             }
 
@@ -1308,12 +1228,12 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
                 timeline_get_by_md5(snac, cmd5, &chd);
 
                 if (older_open && left <= 3) {
-                    ss = xs_str_cat(ss, "</details>\n");
+                    xs_sbuf_cat(b, "</details>\n");
                     older_open = 0;
                 }
 
                 if (chd != NULL && xs_is_null(xs_dict_get(chd, "name"))) {
-                    ss = html_entry(snac, ss, chd, local, level + 1, cmd5, hide_children);
+                    html_entry(snac, b, chd, local, level + 1, cmd5, hide_children, thread);
                     n_children++;
                 }
                 else
@@ -1323,25 +1243,26 @@ xs_str *html_entry(snac *snac, xs_str *os, const xs_dict *msg, int local,
             }
 
             if (older_open)
-                ss = xs_str_cat(ss, "</details>\n");
+                xs_sbuf_cat(b, "</details>\n");
 
-            ss = xs_str_cat(ss, "</div>\n");
-            ss = xs_str_cat(ss, "</details>\n");
+            xs_sbuf_cat(b, "</div>\n");
+            xs_sbuf_cat(b, "</details>\n");
 
-            if (n_children)
-                s = xs_str_cat(s, ss);
+            /* no children were shown: drop the empty section */
+            if (!n_children)
+                xs_sbuf_trunc(b, pos);
         }
     }
 
-    s = xs_str_cat(s, "</div>\n</div>\n");
+    xs_sbuf_cat(b, "</div>\n</div>\n");
 
-    return xs_str_cat(os, s);
+    xs_dict_idx_free(&mi);
 }
 
 
-xs_str *html_user_footer(xs_str *s)
+void html_user_footer(xs_sbuf *b)
 {
-    xs *s1 = xs_fmt(
+    xs_sbuf_fmt(b,
         "<div class=\"snac-footer\">\n"
         "<a href=\"%s\">%s</a> - "
         "powered by <a href=\"%s\">"
@@ -1350,26 +1271,26 @@ xs_str *html_user_footer(xs_str *s)
         L("about this site"),
         WHAT_IS_SNAC_URL
     );
-
-    return xs_str_cat(s, s1);
 }
 
 
 xs_str *html_timeline(snac *snac, const xs_list *list, int local, int skip, int show, int show_more)
 /* returns the HTML for the timeline */
 {
-    xs_str *s = xs_str_new(NULL);
+    xs_sbuf b;
     xs_list *p = (xs_list *)list;
     char *v;
     double t = ftime();
 
-    s = html_user_header(snac, s, local);
+    xs_sbuf_init(&b);
+
+    html_user_header(snac, &b, local);
 
     if (!local)
-        s = html_top_controls(snac, s);
+        html_top_controls(snac, &b);
 
-    s = xs_str_cat(s, "<a name=\"snac-posts\"></a>\n");
-    s = xs_str_cat(s, "<div class=\"snac-posts\">\n");
+    xs_sbuf_cat(&b, "<a name=\"snac-posts\"></a>\n");
+    xs_sbuf_cat(&b, "<div class=\"snac-posts\">\n");
 
     while (xs_list_iter(&p, &v)) {
         xs *msg = NULL;
@@ -1377,43 +1298,37 @@ xs_str *html_timeline(snac *snac, const xs_list *list, int local, int skip, int
         if (!valid_status(timeline_get_by_md5(snac, v, &msg)))
             continue;
 
-        s = html_entry(snac, s, msg, local, 0, v, 0);
+        html_entry(snac, &b, msg, local, 0, v, 0, NULL);
     }
 
-    s = xs_str_cat(s, "</div>\n");
+    xs_sbuf_cat(&b, "</div>\n");
 
     if (local) {
-        xs *s1 = xs_fmt(
+        xs_sbuf_fmt(&b,
             "<div class=\"snac-history\">\n"
             "<p class=\"snac-history-title\">%s</p><ul>\n",
             L("History")
         );
 
-        s = xs_str_cat(s, s1);
-
         xs *list = history_list(snac);
         char *p, *v;
 
         p = list;
         while (xs_list_iter(&p, &v)) {
             xs *fn = xs_replace(v, ".html", "");
-            xs *s1 = xs_fmt(
+
+            xs_sbuf_fmt(&b,
                         "<li><a href=\"%s/h/%s\">%s</a></li>\n",
                         snac->actor, v, fn);
-
-            s = xs_str_cat(s, s1);
         }
 
-        s = xs_str_cat(s, "</ul></div>\n");
+        xs_sbuf_cat(&b, "</ul></div>\n");
     }
 
-    {
-        xs *s1 = xs_fmt("<!-- %lf seconds -->\n", ftime() - t);
-        s = xs_str_cat(s, s1);
-    }
+    xs_sbuf_fmt(&b, "<!-- %lf seconds -->\n", ftime() - t);
 
     if (show_more) {
-        xs *s1 = xs_fmt(
+        xs_sbuf_fmt(&b,
             "<p>"
             "<a href=\"%s%s\" name=\"snac-more\">%s</a> - "
             "<a href=\"%s%s?skip=%d&show=%d\" name=\"snac-more\">%s</a>"
@@ -1421,28 +1336,24 @@ xs_str *html_timeline(snac *snac, const xs_list *list, int local, int skip, int
             snac->actor, local ? "" : "/admin", L("Back to top"),
             snac->actor, local ? "" : "/admin", skip + show, show, L("Older entries...")
         );
-
-        s = xs_str_cat(s, s1);
     }
 
-    s = html_user_footer(s);
+    html_user_footer(&b);
 
-    s = xs_str_cat(s, "</body>\n</html>\n");
+    xs_sbuf_cat(&b, "</body>\n</html>\n");
 
-    return s;
+    return xs_sbuf_result(&b);
 }
 
 
-d_char *html_people_list(snac *snac, d_char *os, d_char *list, const char *header, const char *t)
+void html_people_list(snac *snac, xs_sbuf *b, d_char *list, const char *header, const char *t)
 {
-    xs *s = xs_str_new(NULL);
     xs *es1 = encode_html(header);
-    xs *h = xs_fmt("<h2 class=\"snac-header\">%s</h2>\n", es1);
     char *p, *actor_id;
 
-    s = xs_str_cat(s, h);
+    xs_sbuf_fmt(b, "<h2 class=\"snac-header\">%s</h2>\n", es1);
 
-    s = xs_str_cat(s, "<div class=\"snac-posts\">\n");
+    xs_sbuf_cat(b, "<div class=\"snac-posts\">\n");
 
     p = list;
     while (xs_list_iter(&p, &actor_id)) {
@@ -1450,61 +1361,58 @@ d_char *html_people_list(snac *snac, d_char *os, d_char *list, const char *heade
         xs *actor = NULL;
 
         if (valid_status(actor_get(snac, actor_id, &actor))) {
-            s = xs_str_cat(s, "<div class=\"snac-post\">\n<div class=\"snac-post-header\">\n");
+            xs_sbuf_cat(b, "<div class=\"snac-post\">\n<div class=\"snac-post-header\">\n");
 
-            s = html_actor_icon(s, actor, xs_dict_get(actor, "published"), NULL, NULL, 0);
+            html_actor_icon(b, actor, xs_dict_get(actor, "published"), NULL, NULL, 0);
 
-            s = xs_str_cat(s, "</div>\n");
+            xs_sbuf_cat(b, "</div>\n");
 
             /* content (user bio) */
             char *c = xs_dict_get(actor, "summary");
 
             if (!xs_is_null(c)) {
-                s = xs_str_cat(s, "<div class=\"snac-content\">\n");
+                xs_sbuf_cat(b, "<div class=\"snac-content\">\n");
 
                 xs *sc = sanitize(c);
 
                 if (xs_startswith(sc, "<p>"))
-                    s = xs_str_cat(s, sc);
-                else {
-                    xs *s1 = xs_fmt("<p>%s</p>", sc);
-                    s = xs_str_cat(s, s1);
-                }
+                    xs_sbuf_cat(b, sc);
+                else
+                    xs_sbuf_fmt(b, "<p>%s</p>", sc);
 
-                s = xs_str_cat(s, "</div>\n");
+                xs_sbuf_cat(b, "</div>\n");
             }
 
 
             /* buttons */
-            s = xs_str_cat(s, "<div class=\"snac-controls\">\n");
+            xs_sbuf_cat(b, "<div class=\"snac-controls\">\n");
 
-            xs *s1 = xs_fmt(
+            xs_sbuf_fmt(b,
                 "<p><form autocomplete=\"off\" method=\"post\" action=\"%s/admin/action\">\n"
                 "<input type=\"hidden\" name=\"actor\" value=\"%s\">\n"
                 "<input type=\"hidden\" name=\"actor-form\" value=\"yes\">\n",
 
                 snac->actor, actor_id
             );
-            s = xs_str_cat(s, s1);
 
             if (following_check(snac, actor_id))
-                s = html_button(s, "unfollow", L("Unfollow"));
+                html_button(b, "unfollow", L("Unfollow"));
             else {
-                s = html_button(s, "follow", L("Follow"));
+                html_button(b, "follow", L("Follow"));
 
                 if (follower_check(snac, actor_id))
-                    s = html_button(s, "delete", L("Delete"));
+                    html_button(b, "delete", L("Delete"));
             }
 
             if (is_muted(snac, actor_id))
-                s = html_button(s, "unmute", L("Unmute"));
+                html_button(b, "unmute", L("Unmute"));
             else
-                s = html_button(s, "mute", L("MUTE"));
+                html_button(b, "mute", L("MUTE"));
 
-            s = xs_str_cat(s, "</form>\n");
+            xs_sbuf_cat(b, "</form>\n");
 
             /* the post textarea */
-            xs *s2 = xs_fmt(
+            xs_sbuf_fmt(b,
                 "<p><details><summary>%s</summary>\n"
                 "<p><div class=\"snac-note\" id=\"%s_%s_dm\">\n"
                 "<form autocomplete=\"off\" method=\"post\" action=\"%s/admin/note\" "
@@ -1523,60 +1431,63 @@ d_char *html_people_list(snac *snac, d_char *os, d_char *list, const char *heade
                 actor_id,
                 L("Post")
             );
-            s = xs_str_cat(s, s2);
 
-            s = xs_str_cat(s, "</div>\n");
+            xs_sbuf_cat(b, "</div>\n");
 
-            s = xs_str_cat(s, "</div>\n");
+            xs_sbuf_cat(b, "</div>\n");
         }
     }
 
-    s = xs_str_cat(s, "</div>\n");
-
-    return xs_str_cat(os, s);
+    xs_sbuf_cat(b, "</div>\n");
 }
 
 
 d_char *html_people(snac *snac)
 {
-    d_char *s = xs_str_new(NULL);
+    xs_sbuf b;
     xs *wing = following_list(snac);
     xs *wers = follower_list(snac);
 
-    s = html_user_header(snac, s, 0);
+    xs_sbuf_init(&b);
 
-    s = html_people_list(snac, s, wing, L("People you follow"), "i");
+    html_user_header(snac, &b, 0);
 
-    s = html_people_list(snac, s, wers, L("People that follow you"), "e");
+    html_people_list(snac, &b, wing, L("People you follow"), "i");
 
-    s = html_user_footer(s);
+    html_people_list(snac, &b, wers, L("People that follow you"), "e");
 
-    s = xs_str_cat(s, "</body>\n</html>\n");
+    html_user_footer(&b);
 
-    return s;
+    xs_sbuf_cat(&b, "</body>\n</html>\n");
+
+    return xs_sbuf_result(&b);
 }
 
 
 xs_str *html_notifications(snac *snac)
 {
-    xs_str *s  = xs_str_new(NULL);
-    xs *n_list = notify_list(snac, 0);
-    xs *n_time = notify_check_time(snac, 0);
+    xs_sbuf b;
+    int n_new  = notify_new_len(snac);
+    xs *n_list = notify_list(snac, NULL, NULL, XS_ALL);
     xs_list *p = n_list;
     xs_str *v;
+    int n      = 0;
     enum { NHDR_NONE, NHDR_NEW, NHDR_OLD } stage = NHDR_NONE;
 
-    s = html_user_header(snac, s, 0);
+    xs_sbuf_init(&b);
+
+    html_user_header(snac, &b, 0);
 
-    xs *s1 = xs_fmt(
+    xs_sbuf_fmt(&b,
         "<form autocomplete=\"off\" "
         "method=\"post\" action=\"%s/admin/clear-notifications\" id=\"clear\">\n"
         "<input type=\"submit\" class=\"snac-btn-like\" value=\"%s\">\n"
         "</form><p>\n", snac->actor, L("Clear all"));
-    s = xs_str_cat(s, s1);
 
     while (xs_list_iter(&p, &v)) {
-        xs *noti = notify_get(snac, v);
+        /* the first ones in the list are the unseen ones */
+        int is_new = n++ < n_new;
+        xs *noti   = notify_get(snac, v);
 
         if (noti == NULL)
             continue;
@@ -1600,13 +1511,12 @@ xs_str *html_notifications(snac *snac)
 
         xs *a_name = actor_name(actor);
 
-        if (strcmp(v, n_time) > 0) {
+        if (is_new) {
             /* unseen notification */
             if (stage == NHDR_NONE) {
-                xs *s1 = xs_fmt("<h2 class=\"snac-header\">%s</h2>\n", L("New"));
-                s = xs_str_cat(s, s1);
+                xs_sbuf_fmt(&b, "<h2 class=\"snac-header\">%s</h2>\n", L("New"));
 
-                s = xs_str_cat(s, "<div class=\"snac-posts\">\n");
+                xs_sbuf_cat(&b, "<div class=\"snac-posts\">\n");
 
                 stage = NHDR_NEW;
             }
@@ -1615,12 +1525,11 @@ xs_str *html_notifications(snac *snac)
             /* already seen notification */
             if (stage != NHDR_OLD) {
                 if (stage == NHDR_NEW)
-                    s = xs_str_cat(s, "</div>\n");
+                    xs_sbuf_cat(&b, "</div>\n");
 
-                xs *s1 = xs_fmt("<h2 class=\"snac-header\">%s</h2>\n", L("Already seen"));
-                s = xs_str_cat(s, s1);
+                xs_sbuf_fmt(&b, "<h2 class=\"snac-header\">%s</h2>\n", L("Already seen"));
 
-                s = xs_str_cat(s, "<div class=\"snac-posts\">\n");
+                xs_sbuf_cat(&b, "<div class=\"snac-posts\">\n");
 
                 stage = NHDR_OLD;
             }
@@ -1638,45 +1547,42 @@ xs_str *html_notifications(snac *snac)
             label = L("Unfollow");
 
         xs *es1 = encode_html(label);
-        xs *s1 = xs_fmt("<div class=\"snac-post-with-desc\">\n"
+
+        xs_sbuf_fmt(&b, "<div class=\"snac-post-with-desc\">\n"
                         "<p><b>%s by <a href=\"%s\">%s</a></b>:</p>\n",
             es1, actor_id, a_name);
-        s = xs_str_cat(s, s1);
 
         if (strcmp(type, "Follow") == 0 || strcmp(utype, "Follow") == 0) {
-            s = xs_str_cat(s, "<div class=\"snac-post\">\n");
+            xs_sbuf_cat(&b, "<div class=\"snac-post\">\n");
 
-            s = html_actor_icon(s, actor, NULL, NULL, NULL, 0);
+            html_actor_icon(&b, actor, NULL, NULL, NULL, 0);
 
-            s = xs_str_cat(s, "</div>\n");
+            xs_sbuf_cat(&b, "</div>\n");
         }
         else {
             xs *md5 = xs_md5_hex(id, strlen(id));
 
-            s = html_entry(snac, s, obj, 0, 0, md5, 1);
+            html_entry(snac, &b, obj, 0, 0, md5, 1, NULL);
         }
 
-        s = xs_str_cat(s, "</div>\n");
+        xs_sbuf_cat(&b, "</div>\n");
     }
 
-    if (stage == NHDR_NONE) {
-        xs *s1 = xs_fmt("<h2 class=\"snac-header\">%s</h2>\n", L("None"));
-        s = xs_str_cat(s, s1);
-    }
+    if (stage == NHDR_NONE)
+        xs_sbuf_fmt(&b, "<h2 class=\"snac-header\">%s</h2>\n", L("None"));
     else
-        s = xs_str_cat(s, "</div>\n");
+        xs_sbuf_cat(&b, "</div>\n");
 
-    s = html_user_footer(s);
+    html_user_footer(&b);
 
-    s = xs_str_cat(s, "</body>\n</html>\n");
+    xs_sbuf_cat(&b, "</body>\n</html>\n");
 
-    /* set the check time to now */
-    xs *dummy = notify_check_time(snac, 1);
-    dummy = xs_free(dummy);
+    /* all of them have been seen now */
+    notify_seen(snac);
 
     timeline_touch(snac);
 
-    return s;
+    return xs_sbuf_result(&b);
 }
 
 
@@ -1735,9 +1641,26 @@ int html_get_handler(const xs_dict *req, const char *q_path,
     if ((v = xs_dict_get(q_vars, "show")) != NULL)
         show = atoi(v), cache = 0, save = 0;
 
+    const char *inm = xs_dict_get(req, "if-none-match");
+
     if (p_path == NULL) { /** public timeline **/
         xs *h = xs_str_localtime(0, "%Y-%m.html");
+        xs *e = xs_fmt("html public %d %d", skip, show);
+        const char *files[] = { "private.idx", "public.idx", "pinned.idx",
+                                "user.json", "user_o.json", "static/style.css", NULL };
+        xs *list = timeline_list(&snac, "public", skip, show);
+        xs *pins = pinned_list(&snac);
 
+        pins = xs_list_cat(pins, list);
+
+        /* the entries can be edited, liked or replied to without touching the indexes */
+        *etag = etag_build_threads(&snac, e, files, pins);
+
+        if (etag_match(inm, *etag)) {
+            snac_debug(&snac, 1, xs_fmt("local timeline not modified"));
+            status = 304;
+        }
+        else
         if (cache && history_mtime(&snac, h) > timeline_mtime(&snac)) {
             snac_debug(&snac, 1, xs_fmt("serving cached local timeline"));
 
@@ -1746,12 +1669,8 @@ int html_get_handler(const xs_dict *req, const char *q_path,
             status  = 200;
         }
         else {
-            xs *list = timeline_list(&snac, "public", skip, show);
             xs *next = timeline_list(&snac, "public", skip + show, 1);
 
-            xs *pins = pinned_list(&snac);
-            pins = xs_list_cat(pins, list);
-
             *body = html_timeline(&snac, pins, 1, skip, show, xs_list_len(next));
 
             *b_size = strlen(*body);
@@ -1768,6 +1687,23 @@ int html_get_handler(const xs_dict *req, const char *q_path,
             status = 401;
         }
         else {
+            xs *e = xs_fmt("html admin %d %d", skip, show);
+            const char *files[] = { "private.idx", "pinned.idx", "user.json", "user_o.json",
+                                    "static/style.css", "notify.idx", "notify_seen.txt",
+                                    "muted", "hidden", NULL };
+            xs *list = timeline_list(&snac, "private", skip, show);
+            xs *pins = pinned_list(&snac);
+
+            pins = xs_list_cat(pins, list);
+
+            /* the entries can be edited, liked or replied to without touching the indexes */
+            *etag = etag_build_threads(&snac, e, files, pins);
+
+            if (etag_match(inm, *etag)) {
+                snac_debug(&snac, 1, xs_fmt("timeline not modified"));
+                status = 304;
+            }
+            else
             if (cache && history_mtime(&snac, "timeline.html_") > timeline_mtime(&snac)) {
                 snac_debug(&snac, 1, xs_fmt("serving cached timeline"));
 
@@ -1778,12 +1714,8 @@ int html_get_handler(const xs_dict *req, const char *q_path,
             else {
                 snac_debug(&snac, 1, xs_fmt("building timeline"));
 
-                xs *list = timeline_list(&snac, "private", skip, show);
                 xs *next = timeline_list(&snac, "private", skip + show, 1);
 
-                xs *pins = pinned_list(&snac);
-                pins = xs_list_cat(pins, list);
-
                 *body = html_timeline(&snac, pins, 0, skip, show, xs_list_len(next));
 
                 *b_size = strlen(*body);
@@ -1820,15 +1752,23 @@ int html_get_handler(const xs_dict *req, const char *q_path,
     }
     else
     if (xs_startswith(p_path, "p/")) { /** a timeline with just one entry **/
-        xs *id  = xs_fmt("%s/%s", snac.actor, p_path);
-        xs *msg = NULL;
+        xs *id   = xs_fmt("%s/%s", snac.actor, p_path);
+        xs *md5  = xs_md5_hex(id, strlen(id));
+        xs *list = xs_list_new();
+        xs *msg  = NULL;
+        const char *files[] = { "private.idx", "user.json", "user_o.json",
+                                "static/style.css", NULL };
 
-        if (valid_status(object_get(id, &msg))) {
-            xs *md5  = xs_md5_hex(id, strlen(id));
-            xs *list = xs_list_new();
+        list = xs_list_append(list, md5);
 
-            list = xs_list_append(list, md5);
+        /* the entry and its replies can change without touching the index */
+        if (object_here(id))
+            *etag = etag_build_threads(&snac, "html entry", files, list);
 
+        if (etag_match(inm, *etag))
+            status = 304;
+        else
+        if (valid_status(object_get(id, &msg))) {
             *body   = html_timeline(&snac, list, 1, 0, 0, 0);
             *b_size = strlen(*body);
             status  = 200;
@@ -1870,74 +1810,85 @@ int html_get_handler(const xs_dict *req, const char *q_path,
     }
     else
     if (strcmp(p_path, ".rss") == 0) { /** public timeline in RSS format **/
-        d_char *rss;
+        const char *files[] = { "public.idx", "user.json", "user_o.json", NULL };
         xs *elems = timeline_simple_list(&snac, "public", 0, 20);
-        xs *bio   = not_really_markdown(xs_dict_get(snac.config, "bio"), NULL);
-        char *p, *v;
 
-        xs *es1 = encode_html(xs_dict_get(snac.config, "name"));
-        xs *es2 = encode_html(snac.uid);
-        xs *es3 = encode_html(xs_dict_get(srv_config, "host"));
-        xs *es4 = encode_html(bio);
-        rss = xs_fmt(
-            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-            "<rss version=\"0.91\">\n"
-            "<channel>\n"
-            "<title>%s (@%s@%s)</title>\n"
-            "<language>en</language>\n"
-            "<link>%s.rss</link>\n"
-            "<description>%s</description>\n",
-            es1,
-            es2,
-            es3,
-            snac.actor,
-            es4
-        );
+        /* the posts can be edited without touching the index */
+        *etag = etag_build_list(&snac, "rss", files, elems);
 
-        p = elems;
-        while (xs_list_iter(&p, &v)) {
-            xs *msg  = NULL;
+        if (etag_match(inm, *etag)) {
+            snac_debug(&snac, 1, xs_fmt("RSS not modified"));
+            status = 304;
+        }
+        else {
+            d_char *rss;
+            xs *bio   = not_really_markdown(xs_dict_get(snac.config, "bio"), NULL);
+            char *p, *v;
+
+            xs *es1 = encode_html(xs_dict_get(snac.config, "name"));
+            xs *es2 = encode_html(snac.uid);
+            xs *es3 = encode_html(xs_dict_get(srv_config, "host"));
+            xs *es4 = encode_html(bio);
+            rss = xs_fmt(
+                "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<rss version=\"0.91\">\n"
+                "<channel>\n"
+                "<title>%s (@%s@%s)</title>\n"
+                "<language>en</language>\n"
+                "<link>%s.rss</link>\n"
+                "<description>%s</description>\n",
+                es1,
+                es2,
+                es3,
+                snac.actor,
+                es4
+            );
 
-            if (!valid_status(timeline_get_by_md5(&snac, v, &msg)))
-                continue;
+            p = elems;
+            while (xs_list_iter(&p, &v)) {
+                xs *msg  = NULL;
 
-            char *id = xs_dict_get(msg, "id");
+                if (!valid_status(timeline_get_by_md5(&snac, v, &msg)))
+                    continue;
 
-            if (!xs_startswith(id, snac.actor))
-                continue;
+                char *id = xs_dict_get(msg, "id");
 
-            xs *content = sanitize(xs_dict_get(msg, "content"));
-
-            // We SHOULD only use sanitized one for description.
-            // So, only encode for feed title, while the description just keep it sanitized as is.
-            xs *es_title_enc = encode_html(xs_dict_get(msg, "content"));
-            xs *es_title = xs_replace(es_title_enc, "<br>", "\n");
-            xs *title   = xs_str_new(NULL);
-            int i;
-
-            for (i = 0; es_title[i] && es_title[i] != '\n' && i < 50; i++)
-                title = xs_append_m(title, &es_title[i], 1);
-
-            xs *s = xs_fmt(
-                "<item>\n"
-                "<title>%s...</title>\n"
-                "<link>%s</link>\n"
-                "<description>%s</description>\n"
-                "</item>\n",
-                title, id, content
-            );
+                if (!xs_startswith(id, snac.actor))
+                    continue;
 
-            rss = xs_str_cat(rss, s);
-        }
+                xs *content = sanitize(xs_dict_get(msg, "content"));
 
-        rss = xs_str_cat(rss, "</channel>\n</rss>\n");
+                // We SHOULD only use sanitized one for description.
+                // So, only encode for feed title, while the description just keep it sanitized as is.
+                xs *es_title_enc = encode_html(xs_dict_get(msg, "content"));
+                xs *es_title = xs_replace(es_title_enc, "<br>", "\n");
+                xs *title   = xs_str_new(NULL);
+                int i;
 
-        *body   = rss;
-        *b_size = strlen(rss);
-        *ctype  = "application/rss+xml; charset=utf-8";
-        status  = 200;
+                for (i = 0; es_title[i] && es_title[i] != '\n' && i < 50; i++)
+                    title = xs_append_m(title, &es_title[i], 1);
 
-        snac_debug(&snac, 1, xs_fmt("serving RSS"));
+                xs *s = xs_fmt(
+                    "<item>\n"
+                    "<title>%s...</title>\n"
+                    "<link>%s</link>\n"
+                    "<description>%s</description>\n"
+                    "</item>\n",
+                    title, id, content
+                );
+
+                rss = xs_str_cat(rss, s);
+            }
+
+            rss = xs_str_cat(rss, "</channel>\n</rss>\n");
+
+            *body   = rss;
+            *b_size = strlen(rss);
+            *ctype  = "application/rss+xml; charset=utf-8";
+            status  = 200;
+
+            snac_debug(&snac, 1, xs_fmt("serving RSS"));
+        }
     }
     else
         status = 404;
@@ -2107,6 +2058,7 @@ int html_post_handler(const xs_dict *req, const char *q_path,
 
                     /* overwrite object, not updating the indexes */
                     object_add_ow(edit_id, msg);
+                    timeline_touch(&snac);
 
                     /* update message */
                     c_msg = msg_update(&snac, msg);
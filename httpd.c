@@ -39,21 +39,36 @@ const char *nodeinfo_2_0_template = ""
 d_char *nodeinfo_2_0(void)
 /* builds a nodeinfo json object */
 {
-    xs *users   = user_list();
+    xs *users   = user_directory();
     int n_users = xs_list_len(users);
+    int n_month = 0, n_hyear = 0;
     int n_posts = 0; /* to be implemented someday */
+    double t    = ftime();
+    xs_list *p  = users;
+    xs_dict *u;
+
+    /* count the active users by their last login */
+    while (xs_list_iter(&p, &u)) {
+        double ll = xs_number_get(xs_dict_get(u, "lastlog"));
+
+        if (t - ll < 30 * 24 * 3600)
+            n_month++;
+        if (t - ll < 180 * 24 * 3600)
+            n_hyear++;
+    }
 
-    return xs_fmt(nodeinfo_2_0_template, n_users, n_users, n_users, n_posts);
+    return xs_fmt(nodeinfo_2_0_template, n_users, n_month, n_hyear, n_posts);
 }
 
 
-int server_get_handler(xs_dict *req, char *q_path,
-                       char **body, int *b_size, char **ctype)
+int server_get_handler(const xs_dict *req, const char *q_path,
+                       char **body, int *b_size, char **ctype, xs_str **etag)
 /* basic server services */
 {
     int status = 0;
 
     (void)req;
+    (void)etag;
 
     /* is it the server root? */
     if (*q_path == '\0') {
@@ -80,24 +95,19 @@ int server_get_handler(xs_dict *req, char *q_path,
             /* does it have a %userlist% mark? */
             if (xs_str_in(s, "%userlist%") != -1) {
                 char *host = xs_dict_get(srv_config, "host");
-                xs *list = user_list();
-                char *p, *uid;
+                xs *list = user_directory();
+                xs_list *p;
+                xs_dict *e;
                 xs *ul = xs_str_new("<ul class=\"snac-user-list\">\n");
 
                 p = list;
-                while (xs_list_iter(&p, &uid)) {
-                    snac snac;
-
-                    if (user_open(&snac, uid)) {
-                        xs *u = xs_fmt(
-                            "<li><a href=\"%s\">@%s@%s (%s)</a></li>\n",
-                                snac.actor, uid, host,
-                                xs_dict_get(snac.config, "name"));
-
-                        ul = xs_str_cat(ul, u);
+                while (xs_list_iter(&p, &e)) {
+                    xs *u = xs_fmt(
+                        "<li><a href=\"%s\">@%s@%s (%s)</a></li>\n",
+                            xs_dict_get(e, "actor"), xs_dict_get(e, "uid"), host,
+                            xs_dict_get(e, "name"));
 
-                        user_free(&snac);
-                    }
+                    ul = xs_str_cat(ul, u);
                 }
 
                 ul = xs_str_cat(ul, "</ul>\n");
@@ -144,6 +154,102 @@ int server_get_handler(xs_dict *req, char *q_path,
 }
 
 
+/** request routing **/
+
+typedef int (*get_handler)(const xs_dict *req, const char *q_path,
+                           char **body, int *b_size, char **ctype, xs_str **etag);
+typedef int (*post_handler)(const xs_dict *req, const char *q_path,
+                            const char *payload, int p_size,
+                            char **body, int *b_size, char **ctype);
+
+static int webfinger_get(const xs_dict *req, const char *q_path,
+                         char **body, int *b_size, char **ctype, xs_str **etag)
+{
+    (void)etag;
+    return webfinger_get_handler((xs_dict *)req, (char *)q_path, body, b_size, ctype);
+}
+
+
+static int activitypub_post(const xs_dict *req, const char *q_path,
+                            const char *payload, int p_size,
+                            char **body, int *b_size, char **ctype)
+{
+    return activitypub_post_handler(req, q_path, (char *)payload, p_size, body, b_size, ctype);
+}
+
+
+static int html_post(const xs_dict *req, const char *q_path,
+                     const char *payload, int p_size,
+                     char **body, int *b_size, char **ctype)
+{
+    return html_post_handler(req, q_path, (char *)payload, p_size, body, b_size, ctype);
+}
+
+
+#ifndef NO_MASTODON_API
+
+static int oauth_get(const xs_dict *req, const char *q_path,
+                     char **body, int *b_size, char **ctype, xs_str **etag)
+{
+    (void)etag;
+    return oauth_get_handler(req, q_path, body, b_size, ctype);
+}
+
+#endif /* NO_MASTODON_API */
+
+/* the routing table: the matching handlers are tried in order until
+   one of them accepts the request; path is an exact path, a prefix if
+   it ends with a slash, or NULL for the user paths (the fallback) */
+static const struct {
+    const char *method;
+    const char *path;
+    get_handler get;
+    post_handler post;
+} routes[] = {
+    { "GET",  "",                       server_get_handler,      NULL },
+    { "GET",  "/susie.png",             server_get_handler,      NULL },
+    { "GET",  "/favicon.ico",           server_get_handler,      NULL },
+    { "GET",  "/robots.txt",            server_get_handler,      NULL },
+    { "GET",  "/.well-known/nodeinfo",  server_get_handler,      NULL },
+    { "GET",  "/nodeinfo_2_0",          server_get_handler,      NULL },
+    { "GET",  "/.well-known/webfinger", webfinger_get,           NULL },
+#ifndef NO_MASTODON_API
+    { "GET",  "/oauth/",                oauth_get,               NULL },
+    { "GET",  "/api/v1/",               mastoapi_get_handler,    NULL },
+    { "GET",  "/api/v2/",               mastoapi_get_handler,    NULL },
+#endif
+    { "GET",  NULL,                     activitypub_get_handler, NULL },
+    { "GET",  NULL,                     html_get_handler,        NULL },
+#ifndef NO_MASTODON_API
+    { "POST", "/oauth/",                NULL, oauth_post_handler },
+    { "POST", "/api/v1/",               NULL, mastoapi_post_handler },
+    { "POST", "/api/v2/",               NULL, mastoapi_post_handler },
+    { "PUT",  "/api/v1/",               NULL, mastoapi_put_handler },
+    { "PUT",  "/api/v2/",               NULL, mastoapi_put_handler },
+#endif
+    { "POST", NULL,                     NULL, activitypub_post },
+    { "POST", NULL,                     NULL, html_post },
+    { NULL,   NULL,                     NULL, NULL }
+};
+
+
+static int route_match(const char *path, const char *q_path)
+/* checks if a route path matches the query path */
+{
+    size_t sz;
+
+    if (path == NULL)
+        return 1;
+
+    sz = strlen(path);
+
+    if (sz && path[sz - 1] == '/')
+        return strncmp(q_path, path, sz) == 0;
+
+    return strcmp(q_path, path) == 0;
+}
+
+
 void httpd_connection(FILE *f)
 /* the connection processor */
 {
@@ -179,58 +285,20 @@ void httpd_connection(FILE *f)
     if (xs_startswith(q_path, p))
         q_path = xs_crop_i(q_path, strlen(p), 0);
 
-    if (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0) {
-        /* cascade through */
-        if (status == 0)
-            status = server_get_handler(req, q_path, &body, &b_size, &ctype);
-
-        if (status == 0)
-            status = webfinger_get_handler(req, q_path, &body, &b_size, &ctype);
-
-        if (status == 0)
-            status = activitypub_get_handler(req, q_path, &body, &b_size, &ctype);
-
-#ifndef NO_MASTODON_API
-        if (status == 0)
-            status = oauth_get_handler(req, q_path, &body, &b_size, &ctype);
-
-        if (status == 0)
-            status = mastoapi_get_handler(req, q_path, &body, &b_size, &ctype);
-#endif /* NO_MASTODON_API */
-
-        if (status == 0)
-            status = html_get_handler(req, q_path, &body, &b_size, &ctype, &etag);
-    }
-    else
-    if (strcmp(method, "POST") == 0) {
-
-#ifndef NO_MASTODON_API
-        if (status == 0)
-            status = oauth_post_handler(req, q_path,
-                        payload, p_size, &body, &b_size, &ctype);
-
-        if (status == 0)
-            status = mastoapi_post_handler(req, q_path,
-                        payload, p_size, &body, &b_size, &ctype);
-#endif
-
-        if (status == 0)
-            status = activitypub_post_handler(req, q_path,
-                        payload, p_size, &body, &b_size, &ctype);
-
-        if (status == 0)
-            status = html_post_handler(req, q_path,
-                        payload, p_size, &body, &b_size, &ctype);
-    }
-    else
-    if (strcmp(method, "PUT") == 0) {
+    {
+        /* HEAD requests are served by the GET handlers */
+        const char *r_method = strcmp(method, "HEAD") == 0 ? "GET" : method;
+        int n;
 
-#ifndef NO_MASTODON_API
-        if (status == 0)
-            status = mastoapi_put_handler(req, q_path,
-                        payload, p_size, &body, &b_size, &ctype);
-#endif
+        for (n = 0; status == 0 && routes[n].method != NULL; n++) {
+            if (strcmp(routes[n].method, r_method) != 0 || !route_match(routes[n].path, q_path))
+                continue;
 
+            if (routes[n].get != NULL)
+                status = routes[n].get(req, q_path, &body, &b_size, &ctype, &etag);
+            else
+                status = routes[n].post(req, q_path, payload, p_size, &body, &b_size, &ctype);
+        }
     }
 
     /* let's go */
@@ -264,9 +332,27 @@ void httpd_connection(FILE *f)
     headers = xs_dict_append(headers, "content-type", ctype);
     headers = xs_dict_append(headers, "x-creator",    USER_AGENT);
 
-    if (!xs_is_null(etag))
+    if (!xs_is_null(etag)) {
+        xs *cc = NULL;
+
         headers = xs_dict_append(headers, "etag", etag);
 
+        if (xs_str_in(ctype, "activity+json") != -1 || xs_str_in(ctype, "ld+json") != -1) {
+            /* ActivityPub objects can be cached by other servers for a while */
+            const xs_number *ma = xs_dict_get(srv_config, "ap_cache_max_age");
+            int max_age = xs_type(ma) == XSTYPE_NUMBER ? xs_number_get(ma) : 300;
+
+            cc = xs_fmt("public, max-age=%d", max_age);
+        }
+        else
+        if (xs_dict_get(req, "authorization") != NULL)
+            cc = xs_str_new("private, no-cache");
+        else
+            cc = xs_str_new("no-cache");
+
+        headers = xs_dict_append(headers, "cache-control", cc);
+    }
+
     if (b_size == 0 && body != NULL)
         b_size = strlen(body);
 
@@ -281,7 +367,7 @@ void httpd_connection(FILE *f)
     srv_archive("RECV", NULL, req, payload, p_size, status, headers, body, b_size);
 
     /* JSON validation check */
-    if (strcmp(ctype, "application/json") == 0) {
+    if (body != NULL && strcmp(ctype, "application/json") == 0) {
         xs *j = xs_json_loads(body);
 
         if (j == NULL) {
@@ -305,6 +391,36 @@ void term_handler(int s)
 }
 
 
+#ifdef XS_PROFILE
+
+/* set by SIGUSR1 to dump the allocation profile */
+static volatile sig_atomic_t profile_dump = 0;
+
+void profile_handler(int s)
+{
+    (void)s;
+
+    profile_dump = 1;
+}
+
+
+static void profile_write(void)
+/* writes the allocation profile */
+{
+    xs *fn = xs_fmt("%s/xs_profile.txt", srv_basedir);
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        xs_profile_dump(f);
+        fclose(f);
+
+        srv_log(xs_fmt("allocation profile written to %s", fn));
+    }
+}
+
+#endif
+
+
 /** job control **/
 
 /* mutex to access the lists of jobs */
@@ -376,6 +492,9 @@ static void *job_thread(void *arg)
 {
     int pid = (int)(uintptr_t)arg;
 
+    /* allocate each job's values from an arena? */
+    int arena = xs_type(xs_dict_get(srv_config, "request_arenas")) == XSTYPE_TRUE;
+
     srv_debug(1, xs_fmt("job thread %d started", pid));
 
     for (;;) {
@@ -388,6 +507,9 @@ static void *job_thread(void *arg)
         if (job == NULL)
             break;
 
+        if (arena)
+            xs_arena_start();
+
         if (xs_type(job) == XSTYPE_DATA) {
             /* it's a socket */
             FILE *f = NULL;
@@ -401,8 +523,15 @@ static void *job_thread(void *arg)
             /* it's a q_item */
             process_queue_item(job);
         }
+
+        /* everything allocated while processing the job is gone */
+        if (arena)
+            xs_arena_end();
     }
 
+    if (arena)
+        xs_arena_free();
+
     srv_debug(1, xs_fmt("job thread %d stopped", pid));
 
     return NULL;
@@ -447,6 +576,13 @@ static void *background_thread(void *arg)
         /* global queue */
         cnt += process_queue();
 
+#ifdef XS_PROFILE
+        if (profile_dump) {
+            profile_dump = 0;
+            profile_write();
+        }
+#endif
+
         /* time to purge? */
         if ((t = time(NULL)) > purge_time) {
             /* next purge time is tomorrow */
@@ -507,6 +643,9 @@ void httpd(void)
     signal(SIGPIPE, SIG_IGN);
     signal(SIGTERM, term_handler);
     signal(SIGINT,  term_handler);
+#ifdef XS_PROFILE
+    signal(SIGUSR1, profile_handler);
+#endif
 
     srv_log(xs_fmt("httpd start %s:%d %s", address, port, USER_AGENT));
 
@@ -555,6 +694,10 @@ void httpd(void)
 
     srv_debug(0, xs_fmt("using %d threads", n_threads));
 
+    /* start the log flusher and the archive writer */
+    srv_log_start();
+    srv_archive_start();
+
     /* thread #0 is the background thread */
     pthread_create(&threads[0], NULL, background_thread, NULL);
 
@@ -590,10 +733,15 @@ void httpd(void)
     job_fifo = xs_free(job_fifo);
     pthread_mutex_unlock(&job_mutex);
 
+    /* flush the pending archive entries */
+    srv_archive_stop();
+
     sem_close(job_sem);
     sem_unlink(sem_name);
 
     xs *uptime = xs_str_time_diff(time(NULL) - start_time);
 
     srv_log(xs_fmt("httpd stop %s:%d (run time: %s)", address, port, uptime));
+
+    srv_log_stop();
 }
@@ -14,6 +14,8 @@
 
 #include "snac.h"
 
+#include <pthread.h>
+
 static xs_str *random_str(void)
 /* just what is says in the tin */
 {
@@ -89,6 +91,65 @@ int app_del(const char *id)
 }
 
 
+/* the tokens are checked on every API call, so they are kept in memory
+   for a while once read (or written); deleted tokens are dropped from
+   here at once, and those deleted elsewhere live at most TOKEN_CACHE_SECS */
+
+#ifndef TOKEN_CACHE_SECS
+#define TOKEN_CACHE_SECS 300
+#endif
+
+static pthread_mutex_t token_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xs_dict *token_cache = NULL;     /* id: [ time, token ] */
+
+
+static void _token_cache_set(const char *id, const xs_dict *token)
+/* stores a token in the cache, or drops it if token is NULL */
+{
+    pthread_mutex_lock(&token_cache_mutex);
+
+    if (token_cache == NULL)
+        token_cache = xs_arena_promote(xs_dict_new());
+
+    if (token != NULL) {
+        xs *t = xs_number_new(time(NULL));
+        xs *e = xs_list_new();
+
+        e = xs_list_append(e, t);
+        e = xs_list_append(e, token);
+
+        token_cache = xs_dict_set(token_cache, id, e);
+    }
+    else
+        token_cache = xs_dict_del(token_cache, id);
+
+    pthread_mutex_unlock(&token_cache_mutex);
+}
+
+
+static xs_dict *_token_cache_get(const char *id)
+/* gets a token from the cache, or NULL */
+{
+    xs_dict *token = NULL;
+    const xs_list *e;
+
+    pthread_mutex_lock(&token_cache_mutex);
+
+    if (token_cache != NULL && (e = xs_dict_get(token_cache, id)) != NULL) {
+        time_t t = xs_number_get(xs_list_get(e, 0));
+
+        if (time(NULL) - t < TOKEN_CACHE_SECS)
+            token = xs_dup(xs_list_get(e, 1));
+        else
+            token_cache = xs_dict_del(token_cache, id);
+    }
+
+    pthread_mutex_unlock(&token_cache_mutex);
+
+    return token;
+}
+
+
 int token_add(const char *id, const xs_dict *token)
 /* stores a token */
 {
@@ -107,6 +168,8 @@ int token_add(const char *id, const xs_dict *token)
         xs *j = xs_json_dumps_pp(token, 4);
         fwrite(j, strlen(j), 1, f);
         fclose(f);
+
+        _token_cache_set(id, token);
     }
     else
         status = 500;
@@ -121,15 +184,20 @@ xs_dict *token_get(const char *id)
     if (!xs_is_hex(id))
         return NULL;
 
-    xs *fn         = xs_fmt("%s/token/%s.json", srv_basedir, id);
-    xs_dict *token = NULL;
+    xs_dict *token = _token_cache_get(id);
+
+    if (token != NULL)
+        return token;
+
+    xs *fn = xs_fmt("%s/token/%s.json", srv_basedir, id);
     FILE *f;
 
     if ((f = fopen(fn, "r")) != NULL) {
         xs *j = xs_readall(f);
         fclose(f);
 
-        token = xs_json_loads(j);
+        if ((token = xs_json_loads(j)) != NULL)
+            _token_cache_set(id, token);
     }
 
     return token;
@@ -144,6 +212,8 @@ int token_del(const char *id)
 
     xs *fn = xs_fmt("%s/token/%s.json", srv_basedir, id);
 
+    _token_cache_set(id, NULL);
+
     return unlink(fn);
 }
 
@@ -486,6 +556,16 @@ xs_str *mastoapi_id(const xs_dict *msg)
 #define MID_TO_MD5(id) (id + 10)
 
 
+static xs_str *_mid_to_tid(const char *mid)
+/* converts a Mastodon notification id back to a tid */
+{
+    if (xs_is_null(mid) || strlen(mid) != 16)
+        return NULL;
+
+    return xs_fmt("%.10s.%s", mid, mid + 10);
+}
+
+
 xs_dict *mastoapi_account(const xs_dict *actor)
 /* converts an ActivityPub actor to a Mastodon account */
 {
@@ -653,8 +733,12 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     if (actor == NULL)
         return NULL;
 
-    const char *type = xs_dict_get(msg, "type");
-    const char *id   = xs_dict_get(msg, "id");
+    /* many lookups into msg follow */
+    xs_dict_idx mi;
+    xs_dict_idx_init(&mi, msg);
+
+    const char *type = xs_dict_idx_get(&mi, "type");
+    const char *id   = xs_dict_idx_get(&mi, "id");
 
     xs *acct = mastoapi_account(actor);
 
@@ -668,20 +752,20 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "id",           mid);
     st = xs_dict_append(st, "uri",          id);
     st = xs_dict_append(st, "url",          id);
-    st = xs_dict_append(st, "created_at",   xs_dict_get(msg, "published"));
+    st = xs_dict_append(st, "created_at",   xs_dict_idx_get(&mi, "published"));
     st = xs_dict_append(st, "account",      acct);
-    st = xs_dict_append(st, "content",      xs_dict_get(msg, "content"));
+    st = xs_dict_append(st, "content",      xs_dict_idx_get(&mi, "content"));
 
     st = xs_dict_append(st, "visibility",
         is_msg_public(snac, msg) ? "public" : "private");
 
-    tmp = xs_dict_get(msg, "sensitive");
+    tmp = xs_dict_idx_get(&mi, "sensitive");
     if (xs_is_null(tmp))
         tmp = xs_stock_false;
 
     st = xs_dict_append(st, "sensitive",    tmp);
 
-    tmp = xs_dict_get(msg, "summary");
+    tmp = xs_dict_idx_get(&mi, "summary");
     if (xs_is_null(tmp))
         tmp = "";
 
@@ -689,7 +773,7 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
 
     /* create the list of attachments */
     xs *matt = xs_list_new();
-    xs_list *att = xs_dict_get(msg, "attachment");
+    xs_list *att = xs_dict_idx_get(&mi, "attachment");
     xs_str *aobj;
 
     while (xs_list_iter(&att, &aobj)) {
@@ -723,7 +807,7 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
         xs *ml  = xs_list_new();
         xs *htl = xs_list_new();
         xs *eml = xs_list_new();
-        xs_list *p = xs_dict_get(msg, "tag");
+        xs_list *p = xs_dict_idx_get(&mi, "tag");
         xs_dict *v;
         int n = 0;
 
@@ -823,7 +907,7 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "in_reply_to_id",         xs_stock_null);
     st = xs_dict_append(st, "in_reply_to_account_id", xs_stock_null);
 
-    tmp = xs_dict_get(msg, "inReplyTo");
+    tmp = xs_dict_idx_get(&mi, "inReplyTo");
     if (!xs_is_null(tmp)) {
         xs *irto = NULL;
 
@@ -843,13 +927,13 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "card",     xs_stock_null);
     st = xs_dict_append(st, "language", xs_stock_null);
 
-    tmp = xs_dict_get(msg, "sourceContent");
+    tmp = xs_dict_idx_get(&mi, "sourceContent");
     if (xs_is_null(tmp))
         tmp = "";
 
     st = xs_dict_append(st, "text", tmp);
 
-    tmp = xs_dict_get(msg, "updated");
+    tmp = xs_dict_idx_get(&mi, "updated");
     if (xs_is_null(tmp))
         tmp = xs_stock_null;
 
@@ -866,6 +950,8 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
 
     st = xs_dict_append(st, "pinned", is_pinned(snac, id) ? xs_stock_true : xs_stock_false);
 
+    xs_dict_idx_free(&mi);
+
     return st;
 }
 
@@ -938,7 +1024,7 @@ int process_auth_token(snac *snac, const xs_dict *req)
 
 
 int mastoapi_get_handler(const xs_dict *req, const char *q_path,
-                         char **body, int *b_size, char **ctype)
+                         char **body, int *b_size, char **ctype, xs_str **etag)
 {
     (void)b_size;
 
@@ -951,9 +1037,10 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
         printf("mastoapi get:\n%s\n", j);
     }*/
 
-    int status    = 404;
-    xs_dict *args = xs_dict_get(req, "q_vars");
-    xs *cmd       = xs_replace_n(q_path, "/api", "", 1);
+    int status      = 404;
+    xs_dict *args   = xs_dict_get(req, "q_vars");
+    xs *cmd         = xs_replace_n(q_path, "/api", "", 1);
+    const char *inm = xs_dict_get(req, "if-none-match");
 
     snac snac1 = {0};
     int logged_in = process_auth_token(&snac1, req);
@@ -1174,78 +1261,89 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
             if (limit == 0)
                 limit = 20;
 
+            xs *e = xs_json_dumps_pp(args, 0);
+            const char *files[] = { "private.idx", "pinned.idx", "muted", "hidden", NULL };
             xs *timeline = timeline_simple_list(&snac1, "private", 0, 256);
 
-            xs *out      = xs_list_new();
-            xs_list *p   = timeline;
-            xs_str *v;
+            /* the entries can be edited, liked or boosted without touching the index */
+            *etag = etag_build_list(&snac1, e, files, timeline);
 
-            while (xs_list_iter(&p, &v) && cnt < limit) {
-                xs *msg = NULL;
+            if (etag_match(inm, *etag)) {
+                status = 304;
+                srv_debug(2, xs_fmt("mastoapi timeline: not modified"));
+            }
+            else {
+                xs *out      = xs_list_new();
+                xs_list *p   = timeline;
+                xs_str *v;
 
-                /* only return entries older that max_id */
-                if (max_id) {
-                    if (strcmp(v, MID_TO_MD5(max_id)) == 0)
-                        max_id = NULL;
+                while (xs_list_iter(&p, &v) && cnt < limit) {
+                    xs *msg = NULL;
 
-                    continue;
-                }
+                    /* only return entries older that max_id */
+                    if (max_id) {
+                        if (strcmp(v, MID_TO_MD5(max_id)) == 0)
+                            max_id = NULL;
 
-                /* only returns entries newer than since_id */
-                if (since_id) {
-                    if (strcmp(v, MID_TO_MD5(since_id)) == 0)
-                        break;
-                }
+                        continue;
+                    }
 
-                /* only returns entries newer than min_id */
-                /* what does really "Return results immediately newer than ID" mean? */
-                if (min_id) {
-                    if (strcmp(v, MID_TO_MD5(min_id)) == 0)
-                        break;
-                }
+                    /* only returns entries newer than since_id */
+                    if (since_id) {
+                        if (strcmp(v, MID_TO_MD5(since_id)) == 0)
+                            break;
+                    }
 
-                /* get the entry */
-                if (!valid_status(timeline_get_by_md5(&snac1, v, &msg)))
-                    continue;
+                    /* only returns entries newer than min_id */
+                    /* what does really "Return results immediately newer than ID" mean? */
+                    if (min_id) {
+                        if (strcmp(v, MID_TO_MD5(min_id)) == 0)
+                            break;
+                    }
 
-                /* discard non-Notes */
-                const char *type = xs_dict_get(msg, "type");
-                if (strcmp(type, "Note") != 0 && strcmp(type, "Question") != 0)
-                    continue;
+                    /* get the entry */
+                    if (!valid_status(timeline_get_by_md5(&snac1, v, &msg)))
+                        continue;
+
+                    /* discard non-Notes */
+                    const char *type = xs_dict_get(msg, "type");
+                    if (strcmp(type, "Note") != 0 && strcmp(type, "Question") != 0)
+                        continue;
 
 #if 0
-                /* discard notes from people we don't follow with no boosts */
-                if (!following_check(&snac1, xs_dict_get(msg, "attributedTo")) &&
-                    object_announces_len(xs_dict_get(msg, "id")) == 0)
-                    continue;
+                    /* discard notes from people we don't follow with no boosts */
+                    if (!following_check(&snac1, xs_dict_get(msg, "attributedTo")) &&
+                        object_announces_len(xs_dict_get(msg, "id")) == 0)
+                        continue;
 #endif
 
-                /* discard notes from muted morons */
-                if (is_muted(&snac1, xs_dict_get(msg, "attributedTo")))
-                    continue;
+                    /* discard notes from muted morons */
+                    if (is_muted(&snac1, xs_dict_get(msg, "attributedTo")))
+                        continue;
 
-                /* discard hidden notes */
-                if (is_hidden(&snac1, xs_dict_get(msg, "id")))
-                    continue;
+                    /* discard hidden notes */
+                    if (is_hidden(&snac1, xs_dict_get(msg, "id")))
+                        continue;
 
-                /* discard poll votes (they have a name) */
-                if (!xs_is_null(xs_dict_get(msg, "name")))
-                    continue;
+                    /* discard poll votes (they have a name) */
+                    if (!xs_is_null(xs_dict_get(msg, "name")))
+                        continue;
 
-                /* convert the Note into a Mastodon status */
-                xs *st = mastoapi_status(&snac1, msg);
+                    /* convert the Note into a Mastodon status */
+                    xs *st = mastoapi_status(&snac1, msg);
 
-                if (st != NULL)
-                    out = xs_list_append(out, st);
+                    if (st != NULL)
+                        out = xs_list_append(out, st);
 
-                cnt++;
-            }
+                    cnt++;
+                }
 
-            *body  = xs_json_dumps_pp(out, 4);
-            *ctype = "application/json";
-            status = 200;
+                *body  = xs_json_dumps_pp(out, 4);
+                *ctype = "application/json";
+                status = 200;
 
-            srv_debug(2, xs_fmt("mastoapi timeline: returned %d entries", xs_list_len(out)));
+                srv_debug(2, xs_fmt("mastoapi timeline: returned %d entries", xs_list_len(out)));
+            }
         }
         else {
             status = 401; // unauthorized
@@ -1270,35 +1368,45 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
         if (limit == 0)
             limit = 20;
 
+        xs *e = xs_fmt("%s %d", logged_in ? snac1.uid : "", limit);
+        const char *files[] = { "public.idx", NULL };
         xs *timeline = timeline_instance_list(0, limit);
-        xs *out      = xs_list_new();
-        xs_list *p   = timeline;
-        xs_str *md5;
 
-        while (logged_in && xs_list_iter(&p, &md5) && cnt < limit) {
-            xs *msg = NULL;
+        /* the entries can be edited, liked or boosted without touching the index */
+        *etag = etag_build_list(NULL, e, files, timeline);
 
-            /* get the entry */
-            if (!valid_status(object_get_by_md5(md5, &msg)))
-                continue;
+        if (etag_match(inm, *etag))
+            status = 304;
+        else {
+            xs *out      = xs_list_new();
+            xs_list *p   = timeline;
+            xs_str *md5;
 
-            /* discard non-Notes */
-            const char *type = xs_dict_get(msg, "type");
-            if (strcmp(type, "Note") != 0 && strcmp(type, "Question") != 0)
-                continue;
+            while (logged_in && xs_list_iter(&p, &md5) && cnt < limit) {
+                xs *msg = NULL;
 
-            /* convert the Note into a Mastodon status */
-            xs *st = mastoapi_status(&snac1, msg);
+                /* get the entry */
+                if (!valid_status(object_get_by_md5(md5, &msg)))
+                    continue;
+
+                /* discard non-Notes */
+                const char *type = xs_dict_get(msg, "type");
+                if (strcmp(type, "Note") != 0 && strcmp(type, "Question") != 0)
+                    continue;
+
+                /* convert the Note into a Mastodon status */
+                xs *st = mastoapi_status(&snac1, msg);
 
-            if (st != NULL) {
-                out = xs_list_append(out, st);
-                cnt++;
+                if (st != NULL) {
+                    out = xs_list_append(out, st);
+                    cnt++;
+                }
             }
-        }
 
-        *body  = xs_json_dumps_pp(out, 4);
-        *ctype = "application/json";
-        status = 200;
+            *body  = xs_json_dumps_pp(out, 4);
+            *ctype = "application/json";
+            status = 200;
+        }
     }
     else
     if (strcmp(cmd, "/v1/conversations") == 0) { /** **/
@@ -1310,73 +1418,96 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
     else
     if (strcmp(cmd, "/v1/notifications") == 0) { /** **/
         if (logged_in) {
-            xs *l      = notify_list(&snac1, 0);
-            xs *out    = xs_list_new();
-            xs_list *p = l;
-            xs_dict *v;
+            const char *max_id   = xs_dict_get(args, "max_id");
+            const char *since_id = xs_dict_get(args, "since_id");
+            const char *limit_s  = xs_dict_get(args, "limit");
+            xs *max_tid   = _mid_to_tid(max_id);
+            xs *since_tid = _mid_to_tid(since_id);
+            xs *out       = xs_list_new();
             xs_list *excl = xs_dict_get(args, "exclude_types[]");
+            int limit     = 0;
 
-            while (xs_list_iter(&p, &v)) {
-                xs *noti = notify_get(&snac1, v);
+            if (!xs_is_null(limit_s))
+                limit = atoi(limit_s);
 
-                if (noti == NULL)
-                    continue;
+            if (limit <= 0 || limit > 80)
+                limit = 40;
 
-                const char *type  = xs_dict_get(noti, "type");
-                const char *utype = xs_dict_get(noti, "utype");
-                const char *objid = xs_dict_get(noti, "objid");
-                xs *actor = NULL;
-                xs *entry = NULL;
+            /* get them by chunks, as some may be discarded */
+            while (xs_list_len(out) < limit) {
+                xs *l      = notify_list(&snac1, max_tid, since_tid, limit);
+                xs_list *p = l;
+                xs_str *v;
 
-                if (!valid_status(actor_get(&snac1, xs_dict_get(noti, "actor"), &actor)))
-                    continue;
+                if (xs_list_len(l) == 0)
+                    break;
 
-                if (objid != NULL && !valid_status(object_get(objid, &entry)))
-                    continue;
+                while (xs_list_iter(&p, &v) && xs_list_len(out) < limit) {
+                    xs *noti = notify_get(&snac1, v);
 
-                if (is_hidden(&snac1, objid))
-                    continue;
+                    if (noti == NULL)
+                        continue;
 
-                /* convert the type */
-                if (strcmp(type, "Like") == 0)
-                    type = "favourite";
-                else
-                if (strcmp(type, "Announce") == 0)
-                    type = "reblog";
-                else
-                if (strcmp(type, "Follow") == 0)
-                    type = "follow";
-                else
-                if (strcmp(type, "Create") == 0)
-                    type = "mention";
-                else
-                if (strcmp(type, "Update") == 0 && strcmp(utype, "Question") == 0)
-                    type = "poll";
-                else
-                    continue;
+                    const char *type  = xs_dict_get(noti, "type");
+                    const char *utype = xs_dict_get(noti, "utype");
+                    const char *objid = xs_dict_get(noti, "objid");
+                    xs *actor = NULL;
+                    xs *entry = NULL;
 
-                /* excluded type? */
-                if (!xs_is_null(excl) && xs_list_in(excl, type) != -1)
-                    continue;
+                    if (!valid_status(actor_get(&snac1, xs_dict_get(noti, "actor"), &actor)))
+                        continue;
+
+                    if (objid != NULL && !valid_status(object_get(objid, &entry)))
+                        continue;
+
+                    if (is_hidden(&snac1, objid))
+                        continue;
+
+                    /* convert the type */
+                    if (strcmp(type, "Like") == 0)
+                        type = "favourite";
+                    else
+                    if (strcmp(type, "Announce") == 0)
+                        type = "reblog";
+                    else
+                    if (strcmp(type, "Follow") == 0)
+                        type = "follow";
+                    else
+                    if (strcmp(type, "Create") == 0)
+                        type = "mention";
+                    else
+                    if (strcmp(type, "Update") == 0 && strcmp(utype, "Question") == 0)
+                        type = "poll";
+                    else
+                        continue;
 
-                xs *mn = xs_dict_new();
+                    /* excluded type? */
+                    if (!xs_is_null(excl) && xs_list_in(excl, type) != -1)
+                        continue;
 
-                mn = xs_dict_append(mn, "type", type);
+                    xs *mn = xs_dict_new();
 
-                xs *id = xs_replace(xs_dict_get(noti, "id"), ".", "");
-                mn = xs_dict_append(mn, "id", id);
+                    mn = xs_dict_append(mn, "type", type);
 
-                mn = xs_dict_append(mn, "created_at", xs_dict_get(noti, "date"));
+                    xs *id = xs_replace(xs_dict_get(noti, "id"), ".", "");
+                    mn = xs_dict_append(mn, "id", id);
 
-                xs *acct = mastoapi_account(actor);
-                mn = xs_dict_append(mn, "account", acct);
+                    mn = xs_dict_append(mn, "created_at", xs_dict_get(noti, "date"));
 
-                if (strcmp(type, "follow") != 0 && !xs_is_null(objid)) {
-                    xs *st = mastoapi_status(&snac1, entry);
-                    mn = xs_dict_append(mn, "status", st);
+                    xs *acct = mastoapi_account(actor);
+                    mn = xs_dict_append(mn, "account", acct);
+
+                    if (strcmp(type, "follow") != 0 && !xs_is_null(objid)) {
+                        xs *st = mastoapi_status(&snac1, entry);
+                        mn = xs_dict_append(mn, "status", st);
+                    }
+
+                    out = xs_list_append(out, mn);
                 }
 
-                out = xs_list_append(out, mn);
+                /* the next chunk starts after the last one */
+                xs_free(max_tid);
+                max_tid = xs_dup(xs_list_get(l, -1));
             }
 
             *body  = xs_json_dumps_pp(out, 4);
@@ -1545,20 +1676,23 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
                     }
                     else
                     if (strcmp(op, "context") == 0) { /** **/
-                        /* return ancestors and children */
+                        /* return ancestors and descendants */
                         xs *anc = xs_list_new();
                         xs *des = xs_list_new();
                         xs_list *p;
                         xs_str *v;
-                        char pid[64];
+
+                        /* the full conversation is read at once */
+                        xs *thread = object_thread(id);
 
                         /* build the [grand]parent list, moving up */
-                        strncpy(pid, id, sizeof(pid));
+                        xs *up = thread_ancestors(thread, id);
+                        p = up;
 
-                        while (object_parent(pid, pid, sizeof(pid))) {
+                        while (xs_list_iter(&p, &v)) {
                             xs *m2 = NULL;
 
-                            if (valid_status(timeline_get_by_md5(&snac1, pid, &m2))) {
+                            if (valid_status(timeline_get_by_md5(&snac1, v, &m2))) {
                                 xs *st = mastoapi_status(&snac1, m2);
                                 anc = xs_list_insert(anc, 0, st);
                             }
@@ -1566,8 +1700,8 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
                                 break;
                         }
 
-                        /* build the children list */
-                        xs *children = object_children(xs_dict_get(msg, "id"));
+                        /* build the descendant list, in thread order */
+                        xs *children = thread_descendants(thread, id);
                         p = children;
 
                         while (xs_list_iter(&p, &v)) {
@@ -2169,11 +2303,16 @@ int mastoapi_post_handler(const xs_dict *req, const char *q_path,
                         xs_list *choices = xs_dict_get(args, "choices[]");
 
                         if (xs_type(choices) == XSTYPE_LIST) {
+                            xs_list_idx oi = { NULL, 0, NULL };
                             xs_str *v;
 
+                            /* choices come as positions into opts */
+                            if (xs_type(opts) == XSTYPE_LIST)
+                                xs_list_idx_init(&oi, opts);
+
                             while (xs_list_iter(&choices, &v)) {
                                 int io           = atoi(v);
-                                const xs_dict *o = xs_list_get(opts, io);
+                                const xs_dict *o = io >= 0 ? xs_list_idx_get(&oi, io) : NULL;
 
                                 if (o) {
                                     const char *name = xs_dict_get(o, "name");
@@ -2187,6 +2326,8 @@ int mastoapi_post_handler(const xs_dict *req, const char *q_path,
                                 }
                             }
 
+                            xs_list_idx_free(&oi);
+
                             out = mastoapi_poll(&snac, msg);
                         }
                     }
@@ -14,6 +14,7 @@
 #include "xs_mime.h"
 #include "xs_regex.h"
 #include "xs_set.h"
+#include "xs_sbuf.h"
 #include "xs_time.h"
 #include "xs_glob.h"
 #include "xs_random.h"
@@ -22,6 +23,7 @@
 
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 xs_str *srv_basedir = NULL;
 xs_dict *srv_config = NULL;
@@ -88,33 +90,168 @@ int validate_uid(const char *uid)
 }
 
 
-void srv_debug(int level, xs_str *str)
-/* logs a debug message */
+/** logging **/
+
+/* log lines are appended to a buffer that is written by a flusher
+   thread (if running) to stderr and to the daily file in ~/log/,
+   which is kept open until the date changes */
+
+static pthread_mutex_t log_mutex       = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond         = PTHREAD_COND_INITIALIZER;
+static pthread_t log_thread;
+static xs_str *log_buf  = NULL;
+static int log_running  = 0;
+static FILE *log_f      = NULL;
+static char log_date[16] = "";
+
+#ifndef LOG_BUF_FLUSH_SIZE
+#define LOG_BUF_FLUSH_SIZE 65536
+#endif
+
+static void _log_write(const char *lines)
+/* writes a set of log lines */
+{
+    xs *dt = xs_str_localtime(0, "%Y-%m-%d");
+
+    pthread_mutex_lock(&log_write_mutex);
+
+    fputs(lines, stderr);
+
+    /* date change? rotate */
+    if (log_f == NULL || strcmp(dt, log_date) != 0) {
+        xs *lf = xs_fmt("%s/log/%s.log", srv_basedir, dt);
+
+        if (log_f != NULL)
+            fclose(log_f);
+
+        /* if the ~/log/ folder exists, also write to a file there */
+        if ((log_f = fopen(lf, "a")) != NULL)
+            snprintf(log_date, sizeof(log_date), "%s", dt);
+    }
+
+    if (log_f != NULL) {
+        fputs(lines, log_f);
+        fflush(log_f);
+    }
+
+    pthread_mutex_unlock(&log_write_mutex);
+}
+
+
+static void *_log_thread(void *arg)
+/* the log flusher thread */
+{
+    (void)arg;
+
+    pthread_mutex_lock(&log_mutex);
+
+    while (log_running || xs_size(log_buf) > 1) {
+        if (xs_size(log_buf) <= 1) {
+            struct timespec ts;
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+
+            pthread_cond_timedwait(&log_cond, &log_mutex, &ts);
+            continue;
+        }
+
+        /* take the buffer and write it unlocked */
+        xs *lines = log_buf;
+        log_buf   = xs_str_new(NULL);
+
+        pthread_mutex_unlock(&log_mutex);
+
+        _log_write(lines);
+
+        pthread_mutex_lock(&log_mutex);
+    }
+
+    pthread_mutex_unlock(&log_mutex);
+
+    return NULL;
+}
+
+
+void srv_log_start(void)
+/* starts the log flusher thread */
+{
+    pthread_mutex_lock(&log_mutex);
+
+    log_buf     = xs_str_new(NULL);
+    log_running = 1;
+
+    pthread_mutex_unlock(&log_mutex);
+
+    pthread_create(&log_thread, NULL, _log_thread, NULL);
+}
+
+
+void srv_log_stop(void)
+/* flushes the pending log lines and stops the flusher thread */
+{
+    pthread_mutex_lock(&log_mutex);
+
+    if (!log_running) {
+        pthread_mutex_unlock(&log_mutex);
+        return;
+    }
+
+    log_running = 0;
+    pthread_cond_signal(&log_cond);
+
+    pthread_mutex_unlock(&log_mutex);
+
+    pthread_join(log_thread, NULL);
+
+    log_buf = xs_free(log_buf);
+
+    pthread_mutex_lock(&log_write_mutex);
+
+    if (log_f != NULL) {
+        fclose(log_f);
+        log_f = NULL;
+    }
+
+    pthread_mutex_unlock(&log_write_mutex);
+}
+
+
+void _srv_debug(int level, xs_str *str)
+/* logs a debug message (the srv_debug() macro filters by level) */
 {
+    (void)level;
+
     if (xs_str_in(str, srv_basedir) != -1) {
         /* replace basedir with ~ */
         str = xs_replace_i(str, srv_basedir, "~");
     }
 
-    if (dbglevel >= level) {
-        xs *tm = xs_str_localtime(0, "%H:%M:%S");
-        fprintf(stderr, "%s %s\n", tm, str);
+    xs *tm   = xs_str_localtime(0, "%H:%M:%S");
+    xs *line = xs_fmt("%s %s\n", tm, str);
 
-        /* if the ~/log/ folder exists, also write to a file there */
-        xs *dt = xs_str_localtime(0, "%Y-%m-%d");
-        xs *lf = xs_fmt("%s/log/%s.log", srv_basedir, dt);
-        FILE *f;
-        if ((f = fopen(lf, "a")) != NULL) {
-            fprintf(f, "%s %s\n", tm, str);
-            fclose(f);
-        }
+    pthread_mutex_lock(&log_mutex);
+
+    if (log_running) {
+        log_buf = xs_str_cat(log_buf, line);
+
+        if (xs_size(log_buf) > LOG_BUF_FLUSH_SIZE)
+            pthread_cond_signal(&log_cond);
+
+        pthread_mutex_unlock(&log_mutex);
+    }
+    else {
+        /* no flusher thread (e.g. command line); write it now */
+        pthread_mutex_unlock(&log_mutex);
+        _log_write(line);
     }
 
     xs_free(str);
 }
 
 
-void snac_debug(snac *snac, int level, xs_str *str)
+void _snac_debug(snac *snac, int level, xs_str *str)
 /* prints a user debugging information */
 {
     xs *o_str = str;
@@ -125,7 +262,7 @@ void snac_debug(snac *snac, int level, xs_str *str)
         msg = xs_replace_i(msg, snac->basedir, "~");
     }
 
-    srv_debug(level, msg);
+    _srv_debug(level, msg);
 }
 
 
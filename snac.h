@@ -27,8 +27,11 @@ int valid_status(int status);
 xs_str *tid(int offset);
 double ftime(void);
 
-void srv_debug(int level, xs_str *str);
+void _srv_debug(int level, xs_str *str);
+#define srv_debug(level, str) (dbglevel >= (level) ? _srv_debug(level, str) : (void)0)
 #define srv_log(str) srv_debug(0, str)
+void srv_log_start(void);
+void srv_log_stop(void);
 
 int srv_open(char *basedir, int auto_upgrade);
 void srv_free(void);
@@ -47,8 +50,11 @@ int user_open(snac *snac, const char *uid);
 void user_free(snac *snac);
 xs_list *user_list(void);
 int user_open_by_md5(snac *snac, const char *md5);
+xs_list *user_directory(void);
+xs_str *user_find(const char *id);
 
-void snac_debug(snac *snac, int level, xs_str *str);
+void _snac_debug(snac *snac, int level, xs_str *str);
+#define snac_debug(snac, level, str) (dbglevel >= (level) ? _snac_debug(snac, level, str) : (void)0)
 #define snac_log(snac, str) snac_debug(snac, 0, str)
 
 int validate_uid(const char *uid);
@@ -62,6 +68,8 @@ void srv_archive(const char *direction, const char *url, xs_dict *req,
                  const char *body, int b_size);
 void srv_archive_error(const char *prefix, const xs_str *err,
                        const xs_dict *req, const xs_val *data);
+void srv_archive_start(void);
+void srv_archive_stop(void);
 
 double mtime_nl(const char *fn, int *n_link);
 #define mtime(fn) mtime_nl(fn, NULL)
@@ -94,6 +102,12 @@ xs_list *object_children(const char *id);
 xs_list *object_likes(const char *id);
 xs_list *object_announces(const char *id);
 int object_parent(const char *id, char *buf, int size);
+int object_root(const char *md5, char *buf, int size);
+int object_thread_add(const char *p_md5, const char *md5);
+xs_dict *object_thread(const char *md5);
+xs_list *thread_children(const xs_dict *thread, const char *md5);
+xs_list *thread_descendants(const xs_dict *thread, const char *md5);
+xs_list *thread_ancestors(const xs_dict *thread, const char *md5);
 
 int object_user_cache_add(snac *snac, const char *id, const char *cachedir);
 int object_user_cache_del(snac *snac, const char *id, const char *cachedir);
@@ -143,24 +157,32 @@ void static_put(snac *snac, const char *id, const char *data, int size);
 void static_put_meta(snac *snac, const char *id, const char *str);
 xs_str *static_get_meta(snac *snac, const char *id);
 
+xs_str *etag_build(snac *user, const char *extra, const char *files[], const char *obj_id);
+xs_str *etag_build_list(snac *user, const char *extra, const char *files[], const xs_list *md5s);
+xs_str *etag_build_threads(snac *user, const char *extra, const char *files[], const xs_list *md5s);
+int etag_match(const char *inm, const char *etag);
+
 double history_mtime(snac *snac, const char *id);
 void history_add(snac *snac, const char *id, const char *content, int size);
 xs_str *history_get(snac *snac, const char *id);
 int history_del(snac *snac, const char *id);
 xs_list *history_list(snac *snac);
 
+double lastlog_get(snac *snac);
 void lastlog_write(snac *snac, const char *source);
 
-xs_str *notify_check_time(snac *snac, int reset);
+int notify_new_len(snac *snac);
+void notify_seen(snac *snac);
 void notify_add(snac *snac, const char *type, const char *utype,
                 const char *actor, const char *objid);
 xs_dict *notify_get(snac *snac, const char *id);
-xs_list *notify_list(snac *snac, int new_only);
+xs_list *notify_list(snac *snac, const char *max_id, const char *since_id, int show);
 void notify_clear(snac *snac);
 
 void inbox_add(const char *inbox);
 void inbox_add_by_actor(const xs_dict *actor);
 xs_list *inbox_list(void);
+void inbox_flush(int force);
 
 int is_instance_blocked(const char *instance);
 int instance_block(const char *instance);
@@ -245,7 +267,7 @@ void process_queue_item(xs_dict *q_item);
 int process_queue(void);
 
 int activitypub_get_handler(const xs_dict *req, const char *q_path,
-                            char **body, int *b_size, char **ctype);
+                            char **body, int *b_size, char **ctype, xs_str **etag);
 int activitypub_post_handler(const xs_dict *req, const char *q_path,
                              char *payload, int p_size,
                              char **body, int *b_size, char **ctype);
@@ -274,7 +296,7 @@ int oauth_post_handler(const xs_dict *req, const char *q_path,
                        const char *payload, int p_size,
                        char **body, int *b_size, char **ctype);
 int mastoapi_get_handler(const xs_dict *req, const char *q_path,
-                         char **body, int *b_size, char **ctype);
+                         char **body, int *b_size, char **ctype, xs_str **etag);
 int mastoapi_post_handler(const xs_dict *req, const char *q_path,
                           const char *payload, int p_size,
                           char **body, int *b_size, char **ctype);
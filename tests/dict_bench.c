@@ -0,0 +1,143 @@
+/* snac - A simple, minimalistic ActivityPub instance */
+/* copyright (c) 2022 - 2023 grunfink / MIT license */
+
+/* dict lookup benchmark: linear xs_dict_get() against xs_dict_idx */
+
+/* usage: dict_bench [file.json...]
+
+   The lookups are the ones html_entry() and mastoapi_status() do on
+   each message. Without arguments, they are done on a sample Note;
+   otherwise, on the objects in the files (e.g. the ones of an instance, with
+   make bench BENCH_FILES="$(find /var/snac/object -name '*.json' | head -500 | xargs)") */
+
+#define XS_IMPLEMENTATION
+
+#include "../xs.h"
+#include "../xs_io.h"
+#include "../xs_unicode.h"
+#include "../xs_sbuf.h"
+#include "../xs_json.h"
+
+#include <time.h>
+
+#ifndef BENCH_SECS
+#define BENCH_SECS 2.0
+#endif
+
+static const char *sample_note =
+    "{\"@context\":[\"https://www.w3.org/ns/activitystreams\","
+    "{\"Hashtag\":\"as:Hashtag\",\"sensitive\":\"as:sensitive\"}],"
+    "\"id\":\"https://example.org/users/alice/statuses/110123456789\","
+    "\"type\":\"Note\",\"summary\":null,"
+    "\"inReplyTo\":\"https://social.example.com/users/bob/statuses/109876543210\","
+    "\"published\":\"2023-05-14T09:12:44Z\","
+    "\"url\":\"https://example.org/@alice/110123456789\","
+    "\"attributedTo\":\"https://example.org/users/alice\","
+    "\"to\":[\"https://www.w3.org/ns/activitystreams#Public\"],"
+    "\"cc\":[\"https://example.org/users/alice/followers\"],"
+    "\"sensitive\":false,"
+    "\"atomUri\":\"https://example.org/users/alice/statuses/110123456789\","
+    "\"inReplyToAtomUri\":\"https://social.example.com/users/bob/statuses/109876543210\","
+    "\"conversation\":\"tag:example.org,2023-05-14:objectId=1234:objectType=Conversation\","
+    "\"content\":\"<p>Caf\\u00e9 tonight?</p>\","
+    "\"contentMap\":{\"en\":\"<p>Caf\\u00e9 tonight?</p>\"},"
+    "\"attachment\":[],"
+    "\"tag\":[{\"type\":\"Mention\",\"href\":\"https://social.example.com/users/bob\","
+    "\"name\":\"@bob@social.example.com\"}],"
+    "\"replies\":{\"id\":\"https://example.org/users/alice/statuses/110123456789/replies\","
+    "\"type\":\"Collection\"}}";
+
+static const char *keys[] = {
+    "id", "type", "attributedTo", "published", "updated", "inReplyTo",
+    "summary", "sensitive", "content", "sourceContent", "url", "name",
+    "tag", "attachment", "image", "audience", "oneOf", "anyOf", "endTime",
+    "closed", NULL
+};
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, char *argv[])
+{
+    xs *objs = xs_list_new();
+    xs_list *p;
+    xs_dict *v;
+    double t, e_lin, e_idx;
+    int n = 0, r_lin = 0, r_idx = 0, f_lin = 0, f_idx = 0, k;
+
+    if (argc > 1) {
+        for (k = 1; k < argc; k++) {
+            FILE *f;
+
+            if ((f = fopen(argv[k], "r")) != NULL) {
+                xs *j = xs_readall(f);
+                xs *d = xs_json_loads(j);
+
+                if (xs_type(d) == XSTYPE_DICT)
+                    objs = xs_list_append(objs, d);
+
+                fclose(f);
+            }
+        }
+    }
+    else {
+        xs *d = xs_json_loads(sample_note);
+        objs = xs_list_append(objs, d);
+    }
+
+    n = xs_list_len(objs);
+
+    if (n == 0) {
+        printf("dict_bench: no objects\n");
+        return 1;
+    }
+
+    t = now();
+
+    do {
+        p = objs;
+        while (xs_list_iter(&p, &v)) {
+            for (k = 0; keys[k]; k++)
+                f_lin += xs_dict_get(v, keys[k]) != NULL;
+        }
+
+        r_lin++;
+    } while ((e_lin = now() - t) < BENCH_SECS);
+
+    t = now();
+
+    do {
+        p = objs;
+        while (xs_list_iter(&p, &v)) {
+            xs_dict_idx x;
+
+            xs_dict_idx_init(&x, v);
+
+            for (k = 0; keys[k]; k++)
+                f_idx += xs_dict_idx_get(&x, keys[k]) != NULL;
+
+            xs_dict_idx_free(&x);
+        }
+
+        r_idx++;
+    } while ((e_idx = now() - t) < BENCH_SECS);
+
+    /* both must find the same keys */
+    if (f_lin / r_lin != f_idx / r_idx) {
+        printf("dict_bench: the lookups differ\n");
+        return 1;
+    }
+
+    printf("dict: %d objects, %d lookups each, linear %.0f ns, index build + lookups %.0f ns per object\n",
+        n, k, e_lin / r_lin / n * 1e9, e_idx / r_idx / n * 1e9);
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+/* snac - A simple, minimalistic ActivityPub instance */
+/* copyright (c) 2022 - 2023 grunfink / MIT license */
+
+/* JSON parser throughput benchmark */
+
+/* usage: json_bench [file.json...]
+
+   Without arguments, a 200 note outbox is built from a sample
+   ActivityPub Create; otherwise, the files are parsed (e.g. the
+   objects of an instance, with
+   make bench BENCH_FILES="$(find /var/snac/object -name '*.json' | head -500 | xargs)") */
+
+#define XS_IMPLEMENTATION
+
+#include "../xs.h"
+#include "../xs_io.h"
+#include "../xs_unicode.h"
+#include "../xs_sbuf.h"
+#include "../xs_json.h"
+
+#include <time.h>
+
+#ifndef BENCH_SECS
+#define BENCH_SECS 2.0
+#endif
+
+static const char *sample_create =
+    "{\"@context\":[\"https://www.w3.org/ns/activitystreams\","
+    "{\"Hashtag\":\"as:Hashtag\",\"sensitive\":\"as:sensitive\"}],"
+    "\"id\":\"https://example.org/users/alice/statuses/%d/activity\","
+    "\"type\":\"Create\",\"actor\":\"https://example.org/users/alice\","
+    "\"published\":\"2023-05-14T09:12:44Z\","
+    "\"to\":[\"https://www.w3.org/ns/activitystreams#Public\"],"
+    "\"cc\":[\"https://example.org/users/alice/followers\","
+    "\"https://social.example.com/users/bob\"],"
+    "\"object\":{\"id\":\"https://example.org/users/alice/statuses/%d\","
+    "\"type\":\"Note\",\"summary\":null,"
+    "\"inReplyTo\":\"https://social.example.com/users/bob/statuses/109876543210\","
+    "\"published\":\"2023-05-14T09:12:44Z\","
+    "\"url\":\"https://example.org/@alice/%d\","
+    "\"attributedTo\":\"https://example.org/users/alice\","
+    "\"to\":[\"https://www.w3.org/ns/activitystreams#Public\"],"
+    "\"cc\":[\"https://example.org/users/alice/followers\"],"
+    "\"sensitive\":false,"
+    "\"content\":\"\\u003cp\\u003e\\u003cspan class=\\\"h-card\\\"\\u003e"
+    "\\u003ca href=\\\"https://social.example.com/@bob\\\" class=\\\"u-url mention\\\"\\u003e"
+    "@\\u003cspan\\u003ebob\\u003c/span\\u003e\\u003c/a\\u003e\\u003c/span\\u003e "
+    "Caf\\u00e9 tonight? The new place near the station has a really nice "
+    "terrace and they say the coffee is \\\"excellent\\\" \\ud83d\\ude00 "
+    "\\u003ca href=\\\"https://example.org/tags/coffee\\\" class=\\\"mention hashtag\\\" "
+    "rel=\\\"tag\\\"\\u003e#\\u003cspan\\u003ecoffee\\u003c/span\\u003e\\u003c/a\\u003e"
+    "\\u003c/p\\u003e\","
+    "\"contentMap\":{\"en\":\"\\u003cp\\u003eCaf\\u00e9 tonight?\\u003c/p\\u003e\"},"
+    "\"attachment\":[{\"type\":\"Document\",\"mediaType\":\"image/jpeg\","
+    "\"url\":\"https://example.org/system/media/attachments/files/110/123/456/original/a1b2c3.jpg\","
+    "\"name\":\"A terrace\\nwith tables and chairs\",\"blurhash\":\"UFHUu|?b9F%%M{_3IUIURjxu%%Mt7IU9Fxu\","
+    "\"width\":1200,\"height\":800}],"
+    "\"tag\":[{\"type\":\"Mention\",\"href\":\"https://social.example.com/users/bob\","
+    "\"name\":\"@bob@social.example.com\"},{\"type\":\"Hashtag\","
+    "\"href\":\"https://example.org/tags/coffee\",\"name\":\"#coffee\"}],"
+    "\"replies\":{\"id\":\"https://example.org/users/alice/statuses/%d/replies\","
+    "\"type\":\"Collection\",\"first\":{\"type\":\"CollectionPage\","
+    "\"next\":\"https://example.org/users/alice/statuses/%d/replies?only_other_accounts=true&page=true\","
+    "\"partOf\":\"https://example.org/users/alice/statuses/%d/replies\",\"items\":[]}}}}";
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, char *argv[])
+{
+    xs *docs = xs_list_new();
+    xs_list *p;
+    xs_str *v;
+    double size = 0.0, t, e;
+    int n, rounds = 0;
+
+    if (argc > 1) {
+        for (n = 1; n < argc; n++) {
+            FILE *f;
+
+            if ((f = fopen(argv[n], "r")) != NULL) {
+                xs *j = xs_readall(f);
+                docs = xs_list_append(docs, j);
+                fclose(f);
+            }
+        }
+    }
+    else {
+        xs *j = xs_str_new("{\"@context\":\"https://www.w3.org/ns/activitystreams\","
+            "\"id\":\"https://example.org/users/alice/outbox\","
+            "\"type\":\"OrderedCollection\",\"totalItems\":200,\"orderedItems\":[");
+
+        for (n = 0; n < 200; n++) {
+            xs *c = xs_fmt(sample_create, n, n, n, n, n, n);
+
+            if (n)
+                j = xs_str_cat(j, ",");
+
+            j = xs_str_cat(j, c);
+        }
+
+        j = xs_str_cat(j, "]}");
+
+        docs = xs_list_append(docs, j);
+    }
+
+    /* all must be valid */
+    n = 0;
+    p = docs;
+    while (xs_list_iter(&p, &v)) {
+        xs *d = xs_json_loads(v);
+
+        if (d == NULL) {
+            printf("json_bench: document %d does not parse\n", n);
+            return 1;
+        }
+
+        size += strlen(v);
+        n++;
+    }
+
+    if (n == 0) {
+        printf("json_bench: no documents\n");
+        return 1;
+    }
+
+    t = now();
+
+    do {
+        p = docs;
+        while (xs_list_iter(&p, &v)) {
+            xs *d = xs_json_loads(v);
+        }
+
+        rounds++;
+    } while ((e = now() - t) < BENCH_SECS);
+
+    printf("json: %d documents, %d rounds, %.1f MB/s\n",
+        n, rounds, size * rounds / e / (1024 * 1024));
+
+    return 0;
+}
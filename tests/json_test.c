@@ -0,0 +1,79 @@
+/* snac - A simple, minimalistic ActivityPub instance */
+/* copyright (c) 2022 - 2023 grunfink / MIT license */
+
+/* JSON parser regression tests */
+
+#define XS_IMPLEMENTATION
+
+#include "../xs.h"
+#include "../xs_unicode.h"
+#include "../xs_sbuf.h"
+#include "../xs_json.h"
+
+static int errors = 0;
+
+static void check_fail(const char *json)
+/* the JSON must be rejected */
+{
+    xs *v = xs_json_loads(json);
+
+    if (v != NULL) {
+        printf("FAIL: accepted '%.40s'\n", json);
+        errors++;
+    }
+}
+
+
+static void check_str(const char *json, const char *expected)
+/* the JSON must be a one-string array with this value */
+{
+    xs *v = xs_json_loads(json);
+    const char *s;
+
+    if (v == NULL || (s = xs_list_get(v, 0)) == NULL || strcmp(s, expected) != 0) {
+        printf("FAIL: '%s' not decoded as '%s'\n", json, expected);
+        errors++;
+    }
+}
+
+
+int main(void)
+{
+    /* valid escapes */
+    check_str("[\"a\\u0041b\"]", "aAb");
+    check_str("[\"\\u00e9\"]", "\xc3\xa9");
+    check_str("[\"\\ud83d\\ude00\"]", "\xf0\x9f\x98\x80");
+    check_str("[\"\\\"\\\\\\/\\n\"]", "\"\\/\n");
+
+    /* truncated and odd-length \u escapes */
+    check_fail("[\"\\u\"]");
+    check_fail("[\"\\u1\"]");
+    check_fail("[\"\\u12\"]");
+    check_fail("[\"\\u123\"]");
+    check_fail("[\"\\u12x4\"]");
+    check_fail("[\"\\u12");
+    check_fail("[\"\\ud83d\"]");
+    check_fail("[\"\\ud83d\\u12\"]");
+    check_fail("[\"\\ud83d\\");
+    check_fail("[\"abc\\");
+    check_fail("[\"abc");
+
+    /* an escape that stepped over the closing quote
+       made the decoder copy beyond the allocated block */
+    {
+        xs *j = xs_str_new("[\"\\u12");
+        int n;
+
+        for (n = 0; n < 1000; n++)
+            j = xs_str_cat(j, "x");
+
+        j = xs_str_cat(j, "\"]");
+
+        check_fail(j);
+    }
+
+    if (errors == 0)
+        printf("json: OK\n");
+
+    return errors != 0;
+}
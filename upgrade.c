@@ -288,6 +288,61 @@ int snac_upgrade(xs_str **error)
 
             nf = 2.7;
         }
+        else
+        if (f < 2.8) {
+            /* build the conversation indexes from the parent ones */
+            xs *spec = xs_fmt("%s/object/" "*/" "*_p.idx", srv_basedir);
+            xs *list = xs_glob(spec, 0, 0);
+            char *p, *v;
+
+            p = list;
+            while (xs_list_iter(&p, &v)) {
+                xs *l   = xs_split(v, "/");
+                xs *md5 = xs_replace(xs_list_get(l, -1), "_p.idx", "");
+                char parent[256];
+
+                if (index_first(v, parent, sizeof(parent)))
+                    object_thread_add(parent, md5);
+            }
+
+            nf = 2.8;
+        }
+        else
+        if (f < 2.9) {
+            /* move the collected inboxes to the registry */
+            xs *dir  = xs_fmt("%s/inbox", srv_basedir);
+            xs *spec = xs_fmt("%s/" "*", dir);
+            xs *list = xs_glob(spec, 0, 0);
+            xs *reg  = xs_dict_new();
+            char *p, *v;
+            FILE *f;
+
+            p = list;
+            while (xs_list_iter(&p, &v)) {
+                if ((f = fopen(v, "r")) != NULL) {
+                    xs *line = xs_readline(f);
+                    fclose(f);
+
+                    if (line && *(line = xs_strip_i(line))) {
+                        xs *t = xs_number_new(mtime(v));
+                        reg = xs_dict_append(reg, line, t);
+                    }
+                }
+
+                unlink(v);
+            }
+
+            rmdir(dir);
+
+            xs *fn = xs_fmt("%s/inbox.json", srv_basedir);
+
+            if ((f = fopen(fn, "w")) != NULL) {
+                xs_json_dump(reg, 0, f);
+                fclose(f);
+            }
+
+            nf = 2.9;
+        }
 
         if (f < nf) {
             f          = nf;
@@ -128,20 +128,10 @@ int webfinger_get_handler(d_char *req, char *q_path,
 
     if (xs_startswith(resource, "https:/" "/")) {
         /* actor search: find a user with this actor */
-        xs *list = user_list();
-        char *p, *uid;
-
-        p = list;
-        while (xs_list_iter(&p, &uid)) {
-            if (user_open(&snac, uid)) {
-                if (strcmp(snac.actor, resource) == 0) {
-                    found = 1;
-                    break;
-                }
+        xs *uid = user_find(resource);
 
-                user_free(&snac);
-            }
-        }
+        if (uid != NULL)
+            found = user_open(&snac, uid);
     }
     else
     if (xs_startswith(resource, "acct:")) {
@@ -15,16 +15,16 @@
 
 typedef enum {
     XSTYPE_STRING = 0x02,       /* C string (\0 delimited) (NOT STORED) */
-    XSTYPE_NUMBER = 0x17,       /* double in spirit, stored as a C string (\0 delimited) */
+    XSTYPE_NUMBER = 0x17,       /* Tagged binary integer (long long) or double */
     XSTYPE_NULL   = 0x18,       /* Special NULL value */
     XSTYPE_TRUE   = 0x06,       /* Boolean */
     XSTYPE_FALSE  = 0x15,       /* Boolean */
-    XSTYPE_LIST   = 0x1d,       /* Sequence of LITEMs up to EOM (with 24bit size) */
-    XSTYPE_LITEM  = 0x1f,       /* Element of a list (any type) */
-    XSTYPE_DICT   = 0x1c,       /* Sequence of DITEMs up to EOM (with 24bit size) */
-    XSTYPE_DITEM  = 0x1e,       /* Element of a dict (STRING key + any type) */
+    XSTYPE_LIST   = 0x1d,       /* Sequence of LITEMs up to EOM (with 32bit size and count) */
+    XSTYPE_LITEM  = 0x1f,       /* Element of a list (32bit size + any type) */
+    XSTYPE_DICT   = 0x1c,       /* Sequence of DITEMs up to EOM (with 32bit size) */
+    XSTYPE_DITEM  = 0x1e,       /* Element of a dict (32bit size + STRING key + any type) */
     XSTYPE_EOM    = 0x19,       /* End of Multiple (LIST or DICT) */
-    XSTYPE_DATA   = 0x10        /* A block of anonymous data */
+    XSTYPE_DATA   = 0x10        /* A block of anonymous data (with 32bit size) */
 } xstype;
 
 
@@ -45,11 +45,28 @@ typedef char xs_data;
 /* not really all, just very much */
 #define XS_ALL 0xfffffff
 
+/* header of lists, dicts and data: type + 32 bit size */
+#define _XS_TYPE_SIZE 5
+
+/* list and dict items: type + 32 bit size of the full item, so that
+   walking a list or dict doesn't depend on the size of its values */
+#define _XS_ITEM_HDR 5
+
+/* numbers: type, tag ('i' or 'd') and the 8 byte binary value */
+#define _XS_NUMBER_SIZE 10
+
 void *xs_free(void *ptr);
 void *_xs_realloc(void *ptr, size_t size, const char *file, int line, const char *func);
 #define xs_realloc(ptr, size) _xs_realloc(ptr, size, __FILE__, __LINE__, __FUNCTION__)
 int _xs_blk_size(int sz);
 void _xs_destroy(char **var);
+void xs_arena_start(void);
+void xs_arena_end(void);
+void xs_arena_free(void);
+void *xs_arena_promote(void *ptr);
+#ifdef XS_PROFILE
+void xs_profile_dump(FILE *f);
+#endif
 #define xs_debug() raise(SIGTRAP)
 xstype xs_type(const xs_val *data);
 int xs_size(const xs_val *data);
@@ -82,6 +99,7 @@ xs_str *xs_tolower_i(xs_str *str);
 xs_list *xs_list_new(void);
 xs_list *xs_list_append_m(xs_list *list, const char *mem, int dsz);
 #define xs_list_append(list, data) xs_list_append_m(list, data, xs_size(data))
+xs_list *xs_list_append_strn(xs_list *list, const char *str, int n);
 int xs_list_iter(xs_list **list, xs_val **value);
 int xs_list_len(const xs_list *list);
 xs_val *xs_list_get(const xs_list *list, int num);
@@ -98,6 +116,16 @@ xs_list *xs_split_n(const char *str, const char *sep, int times);
 #define xs_split(str, sep) xs_split_n(str, sep, XS_ALL)
 xs_list *xs_list_cat(xs_list *l1, const xs_list *l2);
 
+typedef struct _xs_list_idx {
+    const xs_list *list;    /* the indexed list */
+    int elems;              /* number of elements */
+    int *offs;              /* offsets to the elements */
+} xs_list_idx;
+
+void xs_list_idx_init(xs_list_idx *x, const xs_list *list);
+xs_val *xs_list_idx_get(const xs_list_idx *x, int num);
+void xs_list_idx_free(xs_list_idx *x);
+
 xs_dict *xs_dict_new(void);
 xs_dict *xs_dict_append_m(xs_dict *dict, const xs_str *key, const xs_val *mem, int dsz);
 #define xs_dict_append(dict, key, data) xs_dict_append_m(dict, key, data, xs_size(data))
@@ -108,10 +136,22 @@ xs_val *xs_dict_get(const xs_dict *dict, const xs_str *key);
 xs_dict *xs_dict_del(xs_dict *dict, const xs_str *key);
 xs_dict *xs_dict_set(xs_dict *dict, const xs_str *key, const xs_val *data);
 
+typedef struct _xs_dict_idx {
+    const xs_dict *dict;    /* the indexed dict */
+    int elems;              /* number of hash entries (a power of 2) */
+    int *hash;              /* offsets to the keys (0: empty) */
+} xs_dict_idx;
+
+void xs_dict_idx_init(xs_dict_idx *x, const xs_dict *dict);
+xs_val *xs_dict_idx_get(const xs_dict_idx *x, const xs_str *key);
+void xs_dict_idx_free(xs_dict_idx *x);
+
 xs_val *xs_val_new(xstype t);
 xs_number *xs_number_new(double f);
+xs_number *xs_number_new_i(long long i);
 double xs_number_get(const xs_number *v);
-const char *xs_number_str(const xs_number *v);
+long long xs_number_get_i(const xs_number *v);
+int xs_number_fmt(const xs_number *v, char *buf, int size);
 
 xs_data *xs_data_new(const void *data, int size);
 int xs_data_size(const xs_data *value);
@@ -148,61 +188,527 @@ xs_val xs_stock_true[]  = { XSTYPE_TRUE };
 xs_val xs_stock_false[] = { XSTYPE_FALSE };
 
 
-void *_xs_realloc(void *ptr, size_t size, const char *file, int line, const char *func)
+/** per-thread arenas **/
+
+/* while an arena is active in a thread, its new allocations are
+   bump-allocated from a list of chunks that are all released at once
+   by xs_arena_end(); values allocated outside keep using malloc() */
+
+#ifndef XS_ARENA_CHUNK_SIZE
+#define XS_ARENA_CHUNK_SIZE 65536
+#endif
+
+/* bigger blocks than this are always malloc()ed */
+#ifndef XS_ARENA_MAX_ALLOC
+#define XS_ARENA_MAX_ALLOC 32768
+#endif
+
+/* bytes of released chunks kept for the next arena in the thread */
+#ifndef XS_ARENA_KEEP
+#define XS_ARENA_KEEP 4194304
+#endif
+
+/* each block is preceded by a header with its capacity */
+#define _XS_ARENA_HDR 16
+
+/* size of the allocation profiler header (keeps alignment) */
+#define _XS_PROF_HDR 16
+
+typedef struct _xs_arena_chunk {
+    struct _xs_arena_chunk *next;
+    char *pos;                  /* first free byte */
+    char *end;                  /* end of the chunk */
+    void *pad;                  /* keeps data 16 byte aligned */
+    char data[];
+} xs_arena_chunk;
+
+static __thread xs_arena_chunk *_xs_arena = NULL;
+static __thread xs_arena_chunk *_xs_arena_spare = NULL;
+static __thread int _xs_arena_spare_size = 0;
+static __thread int _xs_arena_on = 0;
+
+
+static int _xs_arena_owns(const void *ptr)
+/* checks if ptr was allocated from this thread's arena */
 {
-    d_char *ndata = realloc(ptr, size);
+    const xs_arena_chunk *c;
 
-    if (ndata == NULL) {
-        fprintf(stderr, "**OUT OF MEMORY**\n");
-        abort();
+    for (c = _xs_arena; c != NULL; c = c->next) {
+        if ((const char *)ptr >= c->data && (const char *)ptr < c->pos)
+            return 1;
+    }
+
+    return 0;
+}
+
+
+#define _xs_arena_cap(ptr) (*(int *)((char *)(ptr) - _XS_ARENA_HDR))
+
+static void *_xs_arena_alloc(int cap)
+/* allocates a block of cap bytes from the arena */
+{
+    xs_arena_chunk *c = _xs_arena;
+    char *p;
+
+    cap = (cap + 15) & ~15;
+
+    if (c == NULL || c->pos + _XS_ARENA_HDR + cap > c->end) {
+        /* start a new chunk; each one is bigger than the previous */
+        int sz = c ? (c->end - c->data) * 2 : XS_ARENA_CHUNK_SIZE;
+
+        if (sz > XS_ARENA_CHUNK_SIZE * 16)
+            sz = XS_ARENA_CHUNK_SIZE * 16;
+
+        if (sz < _XS_ARENA_HDR + cap)
+            sz = _XS_ARENA_HDR + cap;
+
+        if (_xs_arena_spare != NULL && _xs_arena_spare->end - _xs_arena_spare->data >= sz) {
+            /* reuse a chunk from a previous arena (it's still warm) */
+            c = _xs_arena_spare;
+            _xs_arena_spare = c->next;
+            _xs_arena_spare_size -= c->end - c->data;
+        }
+        else {
+            if ((c = malloc(sizeof(xs_arena_chunk) + sz)) == NULL)
+                return NULL;
+
+            c->end = c->data + sz;
+        }
+
+        c->pos    = c->data;
+        c->next   = _xs_arena;
+        _xs_arena = c;
+    }
+
+    p = c->pos + _XS_ARENA_HDR;
+    c->pos = p + cap;
+
+    _xs_arena_cap(p) = cap;
+
+    return p;
+}
+
+
+static void *_xs_arena_realloc(void *ptr, int size)
+/* the arena version of realloc() */
+{
+    char *n;
+    int cap;
+
+    if (ptr != NULL && !_xs_arena_owns(ptr)) {
+        /* allocated outside the arena: it stays there */
+        return realloc(ptr, size);
+    }
+
+    if (ptr == NULL) {
+        if (size > XS_ARENA_MAX_ALLOC)
+            return malloc(size);
+
+        return _xs_arena_alloc(size);
+    }
+
+    cap = _xs_arena_cap(ptr);
+
+    /* still fits (blocks are never shrunk) */
+    if (size <= cap)
+        return ptr;
+
+    if (size > XS_ARENA_MAX_ALLOC)
+        n = malloc(size);
+    else {
+        xs_arena_chunk *c = _xs_arena;
+
+        /* grow geometrically, as values are usually built by appending */
+        int ncap = cap * 2 > size ? cap * 2 : size;
+
+        if (ncap > XS_ARENA_MAX_ALLOC)
+            ncap = size;
+
+        ncap = (ncap + 15) & ~15;
+
+        /* the last block of the chunk can be grown in place */
+        if ((char *)ptr + cap == c->pos && (char *)ptr + ncap <= c->end) {
+            c->pos = (char *)ptr + ncap;
+            _xs_arena_cap(ptr) = ncap;
+
+            return ptr;
+        }
+
+        n = _xs_arena_alloc(ncap);
+    }
+
+    if (n != NULL)
+        memcpy(n, ptr, cap);
+
+    return n;
+}
+
+
+void xs_arena_start(void)
+/* starts using an arena for this thread's allocations */
+{
+    _xs_arena_on = 1;
+}
+
+
+void xs_arena_end(void)
+/* releases everything allocated from this thread's arena */
+{
+    xs_arena_chunk *l = NULL;
+
+    /* reverse the list, so that the oldest (smallest) chunks come first */
+    while (_xs_arena != NULL) {
+        xs_arena_chunk *c = _xs_arena;
+
+        _xs_arena = c->next;
+        c->next   = l;
+        l         = c;
     }
 
-#ifdef XS_DEBUG
-    if (ndata != ptr) {
-        int n;
-        FILE *f = fopen("xs_memory.out", "a");
+    while (l != NULL) {
+        xs_arena_chunk *c = l;
+        int sz = c->end - c->data;
+
+        l = c->next;
+
+        /* keep some chunks for the next one */
+        if (_xs_arena_spare_size + sz <= XS_ARENA_KEEP) {
+            c->next = _xs_arena_spare;
+            _xs_arena_spare = c;
+            _xs_arena_spare_size += sz;
+        }
+        else
+            free(c);
+    }
+
+    _xs_arena_on = 0;
+}
+
+
+void xs_arena_free(void)
+/* frees the chunks kept by this thread (e.g. when it exits) */
+{
+    while (_xs_arena_spare != NULL) {
+        xs_arena_chunk *c = _xs_arena_spare;
+
+        _xs_arena_spare = c->next;
+        free(c);
+    }
+
+    _xs_arena_spare_size = 0;
+}
+
+
+void *xs_arena_promote(void *ptr)
+/* returns a malloc()ed copy of ptr if it lives in the arena,
+   for values that must outlive it (e.g. stored in globals) */
+{
+    char *p = ptr;
+    int off = 0;
+
+#ifdef XS_PROFILE
+    /* the block really starts at the profiler header */
+    off = ptr ? _XS_PROF_HDR : 0;
+    p  -= off;
+#endif
+
+    if (p != NULL && _xs_arena_on && _xs_arena_owns(p)) {
+        int cap = _xs_arena_cap(p);
+        char *n = malloc(cap);
+
+        if (n == NULL) {
+            fprintf(stderr, "**OUT OF MEMORY**\n");
+            abort();
+        }
+
+        memcpy(n, p, cap);
+        ptr = n + off;
+    }
+
+    return ptr;
+}
+
+
+static void *_xs_realloc_raw(void *ptr, size_t size)
+/* reallocs from the arena or the heap */
+{
+    if (_xs_arena_on)
+        return _xs_arena_realloc(ptr, size);
+
+    return realloc(ptr, size);
+}
+
+
+static void _xs_free_raw(void *ptr)
+/* frees (arena blocks are released all at once) */
+{
+    if (!_xs_arena_on || !_xs_arena_owns(ptr))
+        free(ptr);
+}
+
+
+#ifdef XS_PROFILE
+
+/** allocation profiler **/
+
+/* statistics by call site, in per-thread tables that are only written
+   by their own thread; every block is preceded by a header with its
+   size and the site that allocated it (or resized it last) */
+
+#ifndef XS_PROFILE_SITES
+#define XS_PROFILE_SITES 1024
+#endif
+
+typedef struct {
+    const char *file;
+    const char *func;
+    int line;
+    long allocs;            /* new blocks */
+    long reallocs;          /* resizes of existing blocks */
+    long frees;             /* blocks freed */
+    long long bytes;        /* bytes requested (new blocks and growths) */
+    long long moved;        /* bytes copied by resizes that moved the block */
+    long long live;         /* bytes allocated minus bytes freed */
+    long long peak;         /* highest value of live */
+} xs_prof_site;
+
+typedef struct _xs_prof_table {
+    struct _xs_prof_table *next;
+    xs_prof_site site[XS_PROFILE_SITES];
+} xs_prof_table;
+
+typedef struct {
+    const char *file;
+    int line;
+    int size;
+} xs_prof_hdr;
+
+static xs_prof_table *_xs_prof_tables = NULL;
+static __thread xs_prof_table *_xs_prof = NULL;
+
+
+static xs_prof_site *_xs_prof_site(const char *file, int line)
+/* returns the site entry in this thread's table */
+{
+    xs_prof_table *t = _xs_prof;
+    unsigned int h, n;
+
+    if (t == NULL) {
+        /* first allocation in this thread: create and register its table */
+        if ((t = calloc(1, sizeof(xs_prof_table))) == NULL)
+            return NULL;
+
+        t->next = __atomic_load_n(&_xs_prof_tables, __ATOMIC_ACQUIRE);
+        while (!__atomic_compare_exchange_n(&_xs_prof_tables, &t->next, t,
+                    0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+
+        _xs_prof = t;
+    }
+
+    h = ((unsigned int)(size_t)file >> 3) ^ (line * 2654435761U);
+
+    for (n = 0; n < XS_PROFILE_SITES; n++) {
+        xs_prof_site *s = &t->site[(h + n) % XS_PROFILE_SITES];
+
+        if (s->file == NULL) {
+            s->file = file;
+            s->line = line;
+            return s;
+        }
+
+        if (s->file == file && s->line == line)
+            return s;
+    }
+
+    /* table full */
+    return NULL;
+}
+
+
+static void _xs_prof_live(xs_prof_site *s, long long delta)
+/* updates the live bytes of a site */
+{
+    if (s != NULL) {
+        s->live += delta;
+
+        if (s->live > s->peak)
+            s->peak = s->live;
+    }
+}
+
+
+static void *_xs_prof_realloc(void *ptr, size_t size, const char *file, int line, const char *func)
+/* reallocs, accounting it */
+{
+    xs_prof_hdr *h = ptr ? (xs_prof_hdr *)((char *)ptr - _XS_PROF_HDR) : NULL;
+    xs_prof_hdr old = { NULL, 0, 0 };
+    xs_prof_site *s;
+    char *n;
+
+    if (h != NULL)
+        old = *h;
+
+    if ((n = _xs_realloc_raw(h, size + _XS_PROF_HDR)) == NULL)
+        return NULL;
+
+    if ((s = _xs_prof_site(file, line)) != NULL) {
+        s->func = func;
+
+        if (h == NULL) {
+            s->allocs++;
+            s->bytes += size;
+        }
+        else {
+            s->reallocs++;
+
+            if ((int)size > old.size)
+                s->bytes += size - old.size;
+
+            if (n != (char *)h)
+                s->moved += old.size;
+        }
+    }
+
+    /* the block now belongs to this site */
+    if (h != NULL)
+        _xs_prof_live(_xs_prof_site(old.file, old.line), -old.size);
+
+    _xs_prof_live(s, size);
+
+    h = (xs_prof_hdr *)n;
+    h->file = file;
+    h->line = line;
+    h->size = size;
+
+    return n + _XS_PROF_HDR;
+}
+
+
+static void *_xs_prof_free(void *ptr)
+/* accounts a free, returning the real block */
+{
+    xs_prof_hdr *h = (xs_prof_hdr *)((char *)ptr - _XS_PROF_HDR);
+    xs_prof_site *s;
+
+    if ((s = _xs_prof_site(h->file, h->line)) != NULL) {
+        s->frees++;
+        _xs_prof_live(s, -h->size);
+    }
+
+    return h;
+}
+
+
+static int _xs_prof_cmp(const void *a, const void *b)
+/* sorts by bytes, descending */
+{
+    const xs_prof_site *sa = a;
+    const xs_prof_site *sb = b;
+
+    return sa->bytes < sb->bytes ? 1 : sa->bytes > sb->bytes ? -1 : 0;
+}
+
+
+void xs_profile_dump(FILE *f)
+/* writes the statistics of all threads, merged by call site; as the
+   tables are read while in use, the numbers are approximate */
+{
+    xs_prof_site *all = calloc(XS_PROFILE_SITES, sizeof(xs_prof_site));
+    xs_prof_table *t;
+    int n, i, c = 0;
+
+    if (all == NULL)
+        return;
+
+    for (t = __atomic_load_n(&_xs_prof_tables, __ATOMIC_ACQUIRE); t; t = t->next) {
+        for (n = 0; n < XS_PROFILE_SITES; n++) {
+            const xs_prof_site *s = &t->site[n];
+
+            if (s->file == NULL)
+                continue;
 
-        if (ptr != NULL)
-            fprintf(f, "%p r\n", ptr);
+            for (i = 0; i < c; i++) {
+                if (all[i].file == s->file && all[i].line == s->line)
+                    break;
+            }
 
-        fprintf(f, "%p a %ld %s:%d: %s", ndata, size, file, line, func);
+            if (i == c) {
+                if (c == XS_PROFILE_SITES)
+                    continue;
 
-        if (ptr != NULL) {
-            fprintf(f, " [");
-            for (n = 0; n < 32 && ndata[n]; n++) {
-                if (ndata[n] >= 32 && ndata[n] <= 127)
-                    fprintf(f, "%c", ndata[n]);
-                else
-                    fprintf(f, "\\%02x", (unsigned char)ndata[n]);
+                all[c].file = s->file;
+                all[c].line = s->line;
+                c++;
             }
-            fprintf(f, "]");
+
+            if (s->func != NULL)
+                all[i].func = s->func;
+
+            all[i].allocs   += s->allocs;
+            all[i].reallocs += s->reallocs;
+            all[i].frees    += s->frees;
+            all[i].bytes    += s->bytes;
+            all[i].moved    += s->moved;
+            all[i].live     += s->live;
+
+            /* frees can happen in other threads, so this is per thread */
+            if (s->peak > all[i].peak)
+                all[i].peak = s->peak;
         }
+    }
+
+    qsort(all, c, sizeof(xs_prof_site), _xs_prof_cmp);
 
-        fprintf(f, "\n");
+    fprintf(f, "%10s %10s %10s %14s %14s %12s %12s  %s\n",
+        "allocs", "reallocs", "frees", "bytes", "moved", "live", "peak", "site");
 
-        fclose(f);
+    for (i = 0; i < c; i++) {
+        fprintf(f, "%10ld %10ld %10ld %14lld %14lld %12lld %12lld  %s:%d: %s\n",
+            all[i].allocs, all[i].reallocs, all[i].frees, all[i].bytes,
+            all[i].moved, all[i].live, all[i].peak,
+            all[i].file, all[i].line, all[i].func ? all[i].func : "?");
     }
+
+    free(all);
+}
+
+#endif /* XS_PROFILE */
+
+
+void *_xs_realloc(void *ptr, size_t size, const char *file, int line, const char *func)
+{
+    d_char *ndata;
+
+#ifdef XS_PROFILE
+    ndata = _xs_prof_realloc(ptr, size, file, line, func);
 #else
     (void)file;
     (void)line;
     (void)func;
+
+    ndata = _xs_realloc_raw(ptr, size);
 #endif
 
+    if (ndata == NULL) {
+        fprintf(stderr, "**OUT OF MEMORY**\n");
+        abort();
+    }
+
     return ndata;
 }
 
 
 void *xs_free(void *ptr)
 {
-#ifdef XS_DEBUG
-    if (ptr != NULL) {
-        FILE *f = fopen("xs_memory.out", "a");
-        fprintf(f, "%p b\n", ptr);
-        fclose(f);
-    }
+    if (ptr == NULL)
+        return NULL;
+
+#ifdef XS_PROFILE
+    ptr = _xs_prof_free(ptr);
 #endif
 
-    free(ptr);
+    _xs_free_raw(ptr);
+
     return NULL;
 }
 
@@ -262,23 +768,24 @@ xstype xs_type(const xs_val *data)
 }
 
 
-void _xs_put_24b(xs_val *ptr, int i)
-/* writes i as a 24 bit value */
+void _xs_put_size(xs_val *ptr, int i)
+/* writes i as a 32 bit value */
 {
     unsigned char *p = (unsigned char *)ptr;
 
-    p[0] = (i >> 16) & 0xff;
-    p[1] = (i >> 8) & 0xff;
-    p[2] = i & 0xff;
+    p[0] = (i >> 24) & 0xff;
+    p[1] = (i >> 16) & 0xff;
+    p[2] = (i >> 8) & 0xff;
+    p[3] = i & 0xff;
 }
 
 
-int _xs_get_24b(const xs_val *ptr)
-/* reads a 24 bit value */
+int _xs_get_size(const xs_val *ptr)
+/* reads a 32 bit value */
 {
     unsigned char *p = (unsigned char *)ptr;
 
-    return (p[0] << 16) | (p[1] << 8) | p[2];
+    return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
 }
 
 
@@ -286,7 +793,6 @@ int xs_size(const xs_val *data)
 /* returns the size of data in bytes */
 {
     int len = 0;
-    const char *p;
 
     if (data == NULL)
         return 0;
@@ -299,31 +805,19 @@ int xs_size(const xs_val *data)
     case XSTYPE_LIST:
     case XSTYPE_DICT:
     case XSTYPE_DATA:
-        len = _xs_get_24b(data + 1);
+        len = _xs_get_size(data + 1);
 
         break;
 
     case XSTYPE_DITEM:
-        /* calculate the size of the key and the value */
-        p = data + 1;
-        p += xs_size(p);
-        p += xs_size(p);
-
-        len = p - data;
-
-        break;
-
     case XSTYPE_LITEM:
-        /* it's the size of the item + 1 */
-        p = data + 1;
-        p += xs_size(p);
-
-        len = p - data;
+        /* items store their full size */
+        len = _xs_get_size(data + 1);
 
         break;
 
     case XSTYPE_NUMBER:
-        len = 1 + xs_size(data + 1);
+        len = _XS_NUMBER_SIZE;
 
         break;
 
@@ -370,7 +864,7 @@ xs_val *xs_expand(xs_val *data, int offset, int size)
     if (xs_type(data) == XSTYPE_LIST ||
         xs_type(data) == XSTYPE_DICT ||
         xs_type(data) == XSTYPE_DATA)
-        _xs_put_24b(data + 1, sz + size);
+        _xs_put_size(data + 1, sz + size);
 
     return data;
 }
@@ -395,7 +889,7 @@ xs_val *xs_collapse(xs_val *data, int offset, int size)
     if (xs_type(data) == XSTYPE_LIST ||
         xs_type(data) == XSTYPE_DICT ||
         xs_type(data) == XSTYPE_DATA)
-        _xs_put_24b(data + 1, sz);
+        _xs_put_size(data + 1, sz);
 
     return xs_realloc(data, _xs_blk_size(sz));
 }
@@ -566,30 +1060,49 @@ xs_str *xs_tolower_i(xs_str *str)
 
 /** lists **/
 
+/* list header: type, size and element count */
+#define _XS_LIST_HDR (_XS_TYPE_SIZE + 4)
+
+#define _xs_list_count(list) _xs_get_size((list) + _XS_TYPE_SIZE)
+
+static void _xs_list_count_add(xs_list *list, int n)
+/* adjusts the element count */
+{
+    _xs_put_size(list + _XS_TYPE_SIZE, _xs_list_count(list) + n);
+}
+
+
 xs_list *xs_list_new(void)
 /* creates a new list */
 {
     xs_list *list;
 
-    list = xs_realloc(NULL, _xs_blk_size(5));
+    list = xs_realloc(NULL, _xs_blk_size(_XS_LIST_HDR + 1));
     list[0] = XSTYPE_LIST;
-    list[4] = XSTYPE_EOM;
+    list[_XS_LIST_HDR] = XSTYPE_EOM;
 
-    _xs_put_24b(list + 1, 5);
+    _xs_put_size(list + 1, _XS_LIST_HDR + 1);
+    _xs_put_size(list + _XS_TYPE_SIZE, 0);
 
     return list;
 }
 
 
-xs_list *_xs_list_write_litem(xs_list *list, int offset, const char *mem, int dsz)
-/* writes a list item */
+xs_list *_xs_list_write_litem(xs_list *list, int offset, const char *mem, int dsz, int z)
+/* writes a list item (plus z zeros) */
 {
     XS_ASSERT_TYPE(list, XSTYPE_LIST);
 
-    char c = XSTYPE_LITEM;
+    int isz = _XS_ITEM_HDR + dsz + z;
+
+    list = xs_expand(list, offset, isz);
 
-    list = xs_insert_m(list, offset,     &c,  1);
-    list = xs_insert_m(list, offset + 1, mem, dsz);
+    list[offset] = XSTYPE_LITEM;
+    _xs_put_size(list + offset + 1, isz);
+    memcpy(list + offset + _XS_ITEM_HDR, mem, dsz);
+    memset(list + offset + _XS_ITEM_HDR + dsz, '\0', z);
+
+    _xs_list_count_add(list, 1);
 
     return list;
 }
@@ -600,7 +1113,16 @@ xs_list *xs_list_append_m(xs_list *list, const char *mem, int dsz)
 {
     XS_ASSERT_TYPE(list, XSTYPE_LIST);
 
-    return _xs_list_write_litem(list, xs_size(list) - 1, mem, dsz);
+    return _xs_list_write_litem(list, xs_size(list) - 1, mem, dsz, 0);
+}
+
+
+xs_list *xs_list_append_strn(xs_list *list, const char *str, int n)
+/* adds the first n chars of str to the list as a string */
+{
+    XS_ASSERT_TYPE(list, XSTYPE_LIST);
+
+    return _xs_list_write_litem(list, xs_size(list) - 1, str, n, 1);
 }
 
 
@@ -613,15 +1135,14 @@ int xs_list_iter(xs_list **list, xs_val **value)
 
     /* skip the start of the list */
     if (xs_type(p) == XSTYPE_LIST)
-        p += 4;
+        p += _XS_LIST_HDR;
 
     /* an element? */
     if (xs_type(p) == XSTYPE_LITEM) {
-        p++;
+        *value = p + _XS_ITEM_HDR;
 
-        *value = p;
-
-        p += xs_size(*value);
+        /* jump over the full item */
+        p += _xs_get_size(p + 1);
     }
     else {
         /* end of list */
@@ -640,14 +1161,11 @@ int xs_list_len(const xs_list *list)
 {
     XS_ASSERT_TYPE_NULL(list, XSTYPE_LIST);
 
-    int c = 0;
-    xs_list *p = (xs_list *)list;
-    xs_val *v;
-
-    while (xs_list_iter(&p, &v))
-        c++;
+    if (list == NULL)
+        return 0;
 
-    return c;
+    /* it's kept in the header */
+    return _xs_list_count(list);
 }
 
 
@@ -659,6 +1177,10 @@ xs_val *xs_list_get(const xs_list *list, int num)
     if (num < 0)
         num = xs_list_len(list) + num;
 
+    /* out of range: don't even walk it */
+    if (num < 0 || num >= xs_list_len(list))
+        return NULL;
+
     int c = 0;
     xs_list *p = (xs_list *)list;
     xs_val *v;
@@ -681,8 +1203,11 @@ xs_list *xs_list_del(xs_list *list, int num)
 
     xs_val *v;
 
-    if ((v = xs_list_get(list, num)) != NULL)
-        list = xs_collapse(list, v - 1 - list, xs_size(v - 1));
+    if ((v = xs_list_get(list, num)) != NULL) {
+        v -= _XS_ITEM_HDR;
+        list = xs_collapse(list, v - list, xs_size(v));
+        _xs_list_count_add(list, -1);
+    }
 
     return list;
 }
@@ -696,12 +1221,13 @@ xs_list *xs_list_insert(xs_list *list, int num, const xs_val *data)
     xs_val *v;
     int offset;
 
+    /* insert before the item or at the end */
     if ((v = xs_list_get(list, num)) != NULL)
-        offset = v - list;
+        offset = v - _XS_ITEM_HDR - list;
     else
-        offset = xs_size(list);
+        offset = xs_size(list) - 1;
 
-    return _xs_list_write_litem(list, offset - 1, data, xs_size(data));
+    return _xs_list_write_litem(list, offset, data, xs_size(data), 0);
 }
 
 
@@ -712,18 +1238,18 @@ xs_list *xs_list_insert_sorted(xs_list *list, const xs_str *str)
     XS_ASSERT_TYPE(str, XSTYPE_STRING);
 
     char *p, *v;
-    int offset = xs_size(list);
+    int offset = xs_size(list) - 1;
 
     p = list;
     while (xs_list_iter(&p, &v)) {
         /* if this element is greater or equal, insert here */
         if (strcmp(v, str) >= 0) {
-            offset = v - list;
+            offset = v - _XS_ITEM_HDR - list;
             break;
         }
     }
 
-    return _xs_list_write_litem(list, offset - 1, str, xs_size(str));
+    return _xs_list_write_litem(list, offset, str, xs_size(str), 0);
 }
 
 
@@ -760,7 +1286,9 @@ xs_list *xs_list_dequeue(xs_list *list, xs_val **data, int last)
         *data = xs_dup(v);
 
         /* collapse from the address of the element */
-        list = xs_collapse(list, v - 1 - list, xs_size(v - 1));
+        v -= _XS_ITEM_HDR;
+        list = xs_collapse(list, v - list, xs_size(v));
+        _xs_list_count_add(list, -1);
     }
 
     return list;
@@ -840,11 +1368,8 @@ xs_list *xs_split_n(const char *str, const char *sep, int times)
     list = xs_list_new();
 
     while (times > 0 && (ss = strstr(str, sep)) != NULL) {
-        /* add the first part (without the asciiz) */
-        list = xs_list_append_m(list, str, ss - str);
-
-        /* add the asciiz */
-        list = xs_insert_m(list, xs_size(list) - 1, "", 1);
+        /* add the first part */
+        list = xs_list_append_strn(list, str, ss - str);
 
         /* skip past the separator */
         str = ss + sz;
@@ -865,8 +1390,54 @@ xs_list *xs_list_cat(xs_list *l1, const xs_list *l2)
     XS_ASSERT_TYPE(l1, XSTYPE_LIST);
     XS_ASSERT_TYPE(l2, XSTYPE_LIST);
 
+    int n = _xs_list_count(l2);
+
     /* inserts at the end of l1 the content of l2 (skipping header and footer) */
-    return xs_insert_m(l1, xs_size(l1) - 1, l2 + 4, xs_size(l2) - 5);
+    l1 = xs_insert_m(l1, xs_size(l1) - 1, l2 + _XS_LIST_HDR, xs_size(l2) - _XS_LIST_HDR - 1);
+    _xs_list_count_add(l1, n);
+
+    return l1;
+}
+
+
+void xs_list_idx_init(xs_list_idx *x, const xs_list *list)
+/* builds a table of element offsets for a list that won't change */
+{
+    XS_ASSERT_TYPE(list, XSTYPE_LIST);
+
+    xs_list *p = (xs_list *)list;
+    xs_val *v;
+    int n = 0;
+
+    x->list  = list;
+    x->elems = _xs_list_count(list);
+    x->offs  = xs_realloc(NULL, (x->elems + 1) * sizeof(int));
+
+    while (n < x->elems && xs_list_iter(&p, &v))
+        x->offs[n++] = v - list;
+
+    x->elems = n;
+}
+
+
+xs_val *xs_list_idx_get(const xs_list_idx *x, int num)
+/* returns the element #num of an indexed list (negative: from the end) */
+{
+    if (num < 0)
+        num += x->elems;
+
+    if (num < 0 || num >= x->elems)
+        return NULL;
+
+    return (xs_val *)x->list + x->offs[num];
+}
+
+
+void xs_list_idx_free(xs_list_idx *x)
+/* frees a list index (not the list) */
+{
+    x->offs = xs_free(x->offs);
+    x->list = NULL;
 }
 
 
@@ -877,11 +1448,11 @@ xs_dict *xs_dict_new(void)
 {
     xs_dict *dict;
 
-    dict = xs_realloc(NULL, _xs_blk_size(5));
+    dict = xs_realloc(NULL, _xs_blk_size(_XS_TYPE_SIZE + 1));
     dict[0] = XSTYPE_DICT;
-    dict[4] = XSTYPE_EOM;
+    dict[_XS_TYPE_SIZE] = XSTYPE_EOM;
 
-    _xs_put_24b(dict + 1, 5);
+    _xs_put_size(dict + 1, _XS_TYPE_SIZE + 1);
 
     return dict;
 }
@@ -895,12 +1466,14 @@ xs_dict *xs_dict_insert_m(xs_dict *dict, int offset, const xs_str *key,
     XS_ASSERT_TYPE(key, XSTYPE_STRING);
 
     int ksz = xs_size(key);
+    int isz = _XS_ITEM_HDR + ksz + dsz;
 
-    dict = xs_expand(dict, offset, 1 + ksz + dsz);
+    dict = xs_expand(dict, offset, isz);
 
     dict[offset] = XSTYPE_DITEM;
-    memcpy(&dict[offset + 1], key, ksz);
-    memcpy(&dict[offset + 1 + ksz], data, dsz);
+    _xs_put_size(dict + offset + 1, isz);
+    memcpy(&dict[offset + _XS_ITEM_HDR], key, ksz);
+    memcpy(&dict[offset + _XS_ITEM_HDR + ksz], data, dsz);
 
     return dict;
 }
@@ -916,7 +1489,7 @@ xs_dict *xs_dict_append_m(xs_dict *dict, const xs_str *key, const xs_val *mem, i
 xs_dict *xs_dict_prepend_m(xs_dict *dict, const xs_str *key, const xs_val *mem, int dsz)
 /* prepends a memory block to the dict */
 {
-    return xs_dict_insert_m(dict, 4, key, mem, dsz);
+    return xs_dict_insert_m(dict, _XS_TYPE_SIZE, key, mem, dsz);
 }
 
 
@@ -929,17 +1502,15 @@ int xs_dict_iter(xs_dict **dict, xs_str **key, xs_val **value)
 
     /* skip the start of the list */
     if (xs_type(p) == XSTYPE_DICT)
-        p += 4;
+        p += _XS_TYPE_SIZE;
 
     /* an element? */
     if (xs_type(p) == XSTYPE_DITEM) {
-        p++;
+        *key   = p + _XS_ITEM_HDR;
+        *value = *key + strlen(*key) + 1;
 
-        *key = p;
-        p += xs_size(*key);
-
-        *value = p;
-        p += xs_size(*value);
+        /* jump over the full item */
+        p += _xs_get_size(p + 1);
     }
     else {
         /* end of list */
@@ -964,7 +1535,7 @@ xs_val *xs_dict_get(const xs_dict *dict, const xs_str *key)
     xs_val *v;
 
     while (xs_dict_iter(&p, &k, &v)) {
-        if (strcmp(k, key) == 0)
+        if (*k == *key && strcmp(k, key) == 0)
             return v;
     }
 
@@ -985,7 +1556,7 @@ xs_dict *xs_dict_del(xs_dict *dict, const xs_str *key)
     while (xs_dict_iter(&p, &k, &v)) {
         if (strcmp(k, key) == 0) {
             /* the address of the item is just behind the key */
-            char *i = k - 1;
+            char *i = k - _XS_ITEM_HDR;
 
             dict = xs_collapse(dict, i - dict, xs_size(i));
             break;
@@ -1012,6 +1583,78 @@ xs_dict *xs_dict_set(xs_dict *dict, const xs_str *key, const xs_val *data)
 }
 
 
+/* dict indexes: a read-only hashed view over the keys of an unmodified dict,
+   for code that does many lookups into the same (big) dict */
+
+void xs_dict_idx_init(xs_dict_idx *x, const xs_dict *dict)
+/* builds the index of a dict */
+{
+    XS_ASSERT_TYPE(dict, XSTYPE_DICT);
+
+    xs_dict *p = (xs_dict *)dict;
+    xs_str *k;
+    xs_val *v;
+    int n = 0;
+
+    while (xs_dict_iter(&p, &k, &v))
+        n++;
+
+    /* keep it at most half full */
+    x->dict  = dict;
+    x->elems = 16;
+
+    while (x->elems < n * 2)
+        x->elems *= 2;
+
+    x->hash = xs_realloc(NULL, x->elems * sizeof(int));
+    memset(x->hash, '\0', x->elems * sizeof(int));
+
+    p = (xs_dict *)dict;
+    while (xs_dict_iter(&p, &k, &v)) {
+        unsigned int hash = xs_hash_func(k, strlen(k));
+        int i;
+
+        while ((i = x->hash[hash & (x->elems - 1)]) != 0) {
+            /* repeated key: the first one wins, as in xs_dict_get() */
+            if (strcmp(dict + i, k) == 0)
+                break;
+
+            hash++;
+        }
+
+        if (i == 0)
+            x->hash[hash & (x->elems - 1)] = k - dict;
+    }
+}
+
+
+xs_val *xs_dict_idx_get(const xs_dict_idx *x, const xs_str *key)
+/* returns the value directed by key, using the index */
+{
+    unsigned int hash = xs_hash_func(key, strlen(key));
+    int i;
+
+    while ((i = x->hash[hash & (x->elems - 1)]) != 0) {
+        const char *k = x->dict + i;
+
+        if (strcmp(k, key) == 0)
+            return (xs_val *)k + xs_size(k);
+
+        hash++;
+    }
+
+    return NULL;
+}
+
+
+void xs_dict_idx_free(xs_dict_idx *x)
+/* frees a dict index (not the dict) */
+{
+    x->hash = xs_free(x->hash);
+    x->dict = NULL;
+}
+
+
 /** other values **/
 
 xs_val *xs_val_new(xstype t)
@@ -1027,33 +1670,34 @@ xs_val *xs_val_new(xstype t)
 
 /** numbers */
 
-xs_number *xs_number_new(double f)
-/* adds a new number value */
+static xs_number *_xs_number_new(char tag, const void *bin)
+/* creates a number value from its binary representation */
 {
-    xs_number *v;
-    char tmp[64];
-
-    snprintf(tmp, sizeof(tmp), "%.15lf", f);
+    xs_number *v = xs_realloc(NULL, _xs_blk_size(_XS_NUMBER_SIZE));
 
-    /* strip useless zeros */
-    if (strchr(tmp, '.') != NULL) {
-        char *ptr;
+    v[0] = XSTYPE_NUMBER;
+    v[1] = tag;
+    memcpy(&v[2], bin, 8);
 
-        for (ptr = tmp + strlen(tmp) - 1; *ptr == '0'; ptr--);
+    return v;
+}
 
-        if (*ptr != '.')
-            ptr++;
 
-        *ptr = '\0';
-    }
+xs_number *xs_number_new_i(long long i)
+/* adds a new integer number value */
+{
+    return _xs_number_new('i', &i);
+}
 
-    /* alloc for the marker and the full string */
-    v = xs_realloc(NULL, _xs_blk_size(1 + xs_size(tmp)));
 
-    v[0] = XSTYPE_NUMBER;
-    memcpy(&v[1], tmp, xs_size(tmp));
+xs_number *xs_number_new(double f)
+/* adds a new number value */
+{
+    /* integral values are stored as such, so they print and compare exactly */
+    if (f > -9.2e18 && f < 9.2e18 && f == (long long)f)
+        return xs_number_new_i((long long)f);
 
-    return v;
+    return _xs_number_new('d', &f);
 }
 
 
@@ -1062,22 +1706,69 @@ double xs_number_get(const xs_number *v)
 {
     double f = 0.0;
 
-    if (v != NULL && v[0] == XSTYPE_NUMBER)
-        f = atof(&v[1]);
+    if (v != NULL && v[0] == XSTYPE_NUMBER) {
+        if (v[1] == 'i') {
+            long long i;
+
+            memcpy(&i, &v[2], 8);
+            f = (double)i;
+        }
+        else
+            memcpy(&f, &v[2], 8);
+    }
 
     return f;
 }
 
 
-const char *xs_number_str(const xs_number *v)
-/* gets the number as a string */
+long long xs_number_get_i(const xs_number *v)
+/* gets the number as an integer */
 {
-    const char *p = NULL;
+    long long i = 0;
 
-    if (v != NULL && v[0] == XSTYPE_NUMBER)
-        p = &v[1];
+    if (v != NULL && v[0] == XSTYPE_NUMBER) {
+        if (v[1] == 'i')
+            memcpy(&i, &v[2], 8);
+        else
+            i = (long long)xs_number_get(v);
+    }
 
-    return p;
+    return i;
+}
+
+
+int xs_number_fmt(const xs_number *v, char *buf, int size)
+/* formats the number into buf, returning its length */
+{
+    int n;
+
+    if (v == NULL || v[0] != XSTYPE_NUMBER) {
+        *buf = '\0';
+        return 0;
+    }
+
+    if (v[1] == 'i')
+        return snprintf(buf, size, "%lld", xs_number_get_i(v));
+
+    n = snprintf(buf, size, "%.15lf", xs_number_get(v));
+
+    if (n >= size)
+        n = size - 1;
+
+    /* strip useless zeros */
+    if (strchr(buf, '.') != NULL) {
+        char *ptr;
+
+        for (ptr = buf + n - 1; *ptr == '0'; ptr--);
+
+        if (*ptr != '.')
+            ptr++;
+
+        *ptr = '\0';
+        n = ptr - buf;
+    }
+
+    return n;
 }
 
 
@@ -1088,15 +1779,15 @@ xs_data *xs_data_new(const void *data, int size)
 {
     xs_data *v;
 
-    /* add the overhead (data type + 24bit size) */
-    int total_size = size + 4;
+    /* add the overhead (data type + size) */
+    int total_size = size + _XS_TYPE_SIZE;
 
     v = xs_realloc(NULL, _xs_blk_size(total_size));
     v[0] = XSTYPE_DATA;
 
-    _xs_put_24b(v + 1, total_size);
+    _xs_put_size(v + 1, total_size);
 
-    memcpy(&v[4], data, size);
+    memcpy(&v[_XS_TYPE_SIZE], data, size);
 
     return v;
 }
@@ -1105,15 +1796,15 @@ xs_data *xs_data_new(const void *data, int size)
 int xs_data_size(const xs_data *value)
 /* returns the size of the data stored inside value */
 {
-    return _xs_get_24b(value + 1) - 4;
+    return _xs_get_size(value + 1) - _XS_TYPE_SIZE;
 }
 
 
 void xs_data_get(const xs_data *value, void *data)
 /* copies the raw data stored inside value into data */
 {
-    int size = _xs_get_24b(value + 1) - 4;
-    memcpy(data, &value[4], size);
+    int size = _xs_get_size(value + 1) - _XS_TYPE_SIZE;
+    memcpy(data, &value[_XS_TYPE_SIZE], size);
 }
 
 
@@ -6,6 +6,7 @@
 
 xs_str *xs_json_dumps_pp(const xs_val *data, int indent);
 #define xs_json_dumps(data) xs_json_dumps_pp(data, 0)
+int xs_json_dump(const xs_val *data, int indent, FILE *f);
 xs_val *xs_json_loads(const xs_str *json);
 
 
@@ -15,63 +16,105 @@ xs_val *xs_json_loads(const xs_str *json);
 
 /** JSON dumps **/
 
-static xs_str *_xs_json_dumps_str(xs_str *s, const char *data)
+/* the output sink: a FILE, or a string with its length tracked */
+typedef struct {
+    FILE *f;
+    xs_str *s;
+    int len;
+    int size;
+} _xs_json_out;
+
+
+static void _xs_json_write(_xs_json_out *o, const char *mem, int size)
+/* writes to the output sink */
+{
+    if (o->f != NULL)
+        fwrite(mem, size, 1, o->f);
+    else {
+        if (o->len + size + 1 > o->size) {
+            /* grow geometrically */
+            while (o->len + size + 1 > o->size)
+                o->size *= 2;
+
+            o->s = xs_realloc(o->s, o->size);
+        }
+
+        memcpy(o->s + o->len, mem, size);
+        o->len += size;
+        o->s[o->len] = '\0';
+    }
+}
+
+#define _xs_json_puts(o, str) _xs_json_write(o, str, strlen(str))
+
+
+static void _xs_json_dumps_str(_xs_json_out *o, const char *data)
 /* dumps a string in JSON format */
 {
-    unsigned char c;
-    s = xs_str_cat(s, "\"");
+    _xs_json_write(o, "\"", 1);
+
+    while (*data) {
+        /* write the run of chars that need no escaping at once */
+        const char *p = data;
+        unsigned char c;
+
+        while ((c = *p) >= 32 && c != '\\' && c != '"')
+            p++;
+
+        if (p > data) {
+            _xs_json_write(o, data, p - data);
+            data = p;
+            continue;
+        }
 
-    while ((c = *data)) {
         if (c == '\n')
-            s = xs_str_cat(s, "\\n");
+            _xs_json_write(o, "\\n", 2);
         else
         if (c == '\r')
-            s = xs_str_cat(s, "\\r");
+            _xs_json_write(o, "\\r", 2);
         else
         if (c == '\t')
-            s = xs_str_cat(s, "\\t");
+            _xs_json_write(o, "\\t", 2);
         else
         if (c == '\\')
-            s = xs_str_cat(s, "\\\\");
+            _xs_json_write(o, "\\\\", 2);
         else
         if (c == '"')
-            s = xs_str_cat(s, "\\\"");
-        else
-        if (c < 32) {
+            _xs_json_write(o, "\\\"", 2);
+        else {
             char tmp[10];
 
             snprintf(tmp, sizeof(tmp), "\\u%04x", (unsigned int) c);
-            s = xs_str_cat(s, tmp);
+            _xs_json_puts(o, tmp);
         }
-        else
-            s = xs_append_m(s, data, 1);
 
         data++;
     }
 
-    s = xs_str_cat(s, "\"");
-
-    return s;
+    _xs_json_write(o, "\"", 1);
 }
 
 
-static xs_str *_xs_json_indent(xs_str *s, int level, int indent)
+static void _xs_json_indent(_xs_json_out *o, int level, int indent)
 /* adds indentation */
 {
     if (indent) {
-        int n;
+        static const char spaces[] = "                                ";
+        int n = level * indent;
 
-        s = xs_str_cat(s, "\n");
+        _xs_json_write(o, "\n", 1);
 
-        for (n = 0; n < level * indent; n++)
-            s = xs_str_cat(s, " ");
-    }
+        while (n > 0) {
+            int i = n < (int)sizeof(spaces) - 1 ? n : (int)sizeof(spaces) - 1;
 
-    return s;
+            _xs_json_write(o, spaces, i);
+            n -= i;
+        }
+    }
 }
 
 
-static xs_str *_xs_json_dumps(xs_str *s, const xs_val *s_data, int level, int indent)
+static void _xs_json_dumps(_xs_json_out *o, const xs_val *s_data, int level, int indent)
 /* dumps partial data as JSON */
 {
     int c = 0;
@@ -80,73 +123,78 @@ static xs_str *_xs_json_dumps(xs_str *s, const xs_val *s_data, int level, int in
 
     switch (xs_type(data)) {
     case XSTYPE_NULL:
-        s = xs_str_cat(s, "null");
+        _xs_json_write(o, "null", 4);
         break;
 
     case XSTYPE_TRUE:
-        s = xs_str_cat(s, "true");
+        _xs_json_write(o, "true", 4);
         break;
 
     case XSTYPE_FALSE:
-        s = xs_str_cat(s, "false");
+        _xs_json_write(o, "false", 5);
         break;
 
     case XSTYPE_NUMBER:
-        s = xs_str_cat(s, xs_number_str(data));
+        {
+            char tmp[64];
+            int n = xs_number_fmt(data, tmp, sizeof(tmp));
+
+            _xs_json_write(o, tmp, n);
+        }
+
         break;
 
     case XSTYPE_LIST:
-        s = xs_str_cat(s, "[");
+        _xs_json_write(o, "[", 1);
 
         while (xs_list_iter(&data, &v)) {
             if (c != 0)
-                s = xs_str_cat(s, ",");
+                _xs_json_write(o, ",", 1);
 
-            s = _xs_json_indent(s, level + 1, indent);
-            s = _xs_json_dumps(s, v, level + 1, indent);
+            _xs_json_indent(o, level + 1, indent);
+            _xs_json_dumps(o, v, level + 1, indent);
 
             c++;
         }
 
-        s = _xs_json_indent(s, level, indent);
-        s = xs_str_cat(s, "]");
+        _xs_json_indent(o, level, indent);
+        _xs_json_write(o, "]", 1);
 
         break;
 
     case XSTYPE_DICT:
-        s = xs_str_cat(s, "{");
+        _xs_json_write(o, "{", 1);
 
         xs_str *k;
         while (xs_dict_iter(&data, &k, &v)) {
             if (c != 0)
-                s = xs_str_cat(s, ",");
+                _xs_json_write(o, ",", 1);
 
-            s = _xs_json_indent(s, level + 1, indent);
+            _xs_json_indent(o, level + 1, indent);
 
-            s = _xs_json_dumps_str(s, k);
-            s = xs_str_cat(s, ":");
+            _xs_json_dumps_str(o, k);
 
             if (indent)
-                s = xs_str_cat(s, " ");
+                _xs_json_write(o, ": ", 2);
+            else
+                _xs_json_write(o, ":", 1);
 
-            s = _xs_json_dumps(s, v, level + 1, indent);
+            _xs_json_dumps(o, v, level + 1, indent);
 
             c++;
         }
 
-        s = _xs_json_indent(s, level, indent);
-        s = xs_str_cat(s, "}");
+        _xs_json_indent(o, level, indent);
+        _xs_json_write(o, "}", 1);
         break;
 
     case XSTYPE_STRING:
-        s = _xs_json_dumps_str(s, data);
+        _xs_json_dumps_str(o, data);
         break;
 
     default:
         break;
     }
-
-    return s;
 }
 
 
@@ -157,14 +205,37 @@ xs_str *xs_json_dumps_pp(const xs_val *data, int indent)
     xs_str *s = NULL;
 
     if (t == XSTYPE_LIST || t == XSTYPE_DICT) {
-        s = xs_str_new(NULL);
-        s = _xs_json_dumps(s, data, 0, indent);
+        _xs_json_out o = { NULL, NULL, 0, 256 };
+
+        o.s = xs_realloc(NULL, o.size);
+        o.s[0] = '\0';
+
+        _xs_json_dumps(&o, data, 0, indent);
+
+        s = o.s;
     }
 
     return s;
 }
 
 
+int xs_json_dump(const xs_val *data, int indent, FILE *f)
+/* dumps a piece of data as JSON into a file */
+{
+    xstype t = xs_type(data);
+
+    if (t == XSTYPE_LIST || t == XSTYPE_DICT) {
+        _xs_json_out o = { f, NULL, 0, 0 };
+
+        _xs_json_dumps(&o, data, 0, indent);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+
 /** JSON loads **/
 
 /* this code comes mostly from the Minimum Profit Text Editor (MPDM) */
@@ -190,6 +261,52 @@ typedef enum {
 } js_type;
 
 
+static int _xs_json_hex4(const char *s, int *i)
+/* decodes the hex digits of an \u escape (they must be exactly 4) */
+{
+    int n;
+
+    *i = 0;
+
+    /* a NUL or a quote is not a hex digit, so this never
+       reads beyond the end of the string */
+    for (n = 0; n < 4; n++) {
+        char c = s[n];
+
+        if (c >= '0' && c <= '9')
+            *i = (*i << 4) | (c - '0');
+        else
+        if (c >= 'a' && c <= 'f')
+            *i = (*i << 4) | (c - 'a' + 10);
+        else
+        if (c >= 'A' && c <= 'F')
+            *i = (*i << 4) | (c - 'A' + 10);
+        else
+            return 0;
+    }
+
+    return 1;
+}
+
+
+static xs_number *_xs_json_number(const char *str, js_type t)
+/* converts a number token, keeping integers exact */
+{
+    if (t == JS_INTEGER) {
+        char *e;
+        long long i;
+
+        errno = 0;
+        i = strtoll(str, &e, 10);
+
+        if (errno == 0 && *e == '\0')
+            return xs_number_new_i(i);
+    }
+
+    return xs_number_new(atof(str));
+}
+
+
 static xs_val *_xs_json_loads_lexer(const char **json, js_type *t)
 {
     char c;
@@ -221,103 +338,148 @@ static xs_val *_xs_json_loads_lexer(const char **json, js_type *t)
         *t = JS_COLON;
     else
     if (c == '"') {
+        const char *e = s;
+        char *p;
+
         *t = JS_STRING;
 
-        v = xs_str_new(NULL);
+        /* find the end of the string; the decoded string is
+           never longer than the source, so allocate it only once */
+        while (*(e += strcspn(e, "\"\\")) == '\\' && e[1] != '\0')
+            e += 2;
 
-        while ((c = *s) != '"' && c != '\0') {
-            char tmp[5];
+        v = xs_realloc(NULL, _xs_blk_size(e - s + 1));
+        p = v;
+
+        /* everything is decoded from within [s, e) */
+        while (s < e) {
             int cp, i;
 
-            if (c == '\\') {
-                s++;
-                c = *s;
-                switch (c) {
-                case 'n': c = '\n'; break;
-                case 'r': c = '\r'; break;
-                case 't': c = '\t'; break;
-                case 'u': /* Unicode codepoint as an hex char */
-                    s++;
-                    strncpy(tmp, s, 4);
-                    tmp[4] = '\0';
-
-                    if (strlen(tmp) != 4) {
-                        *t = JS_ERROR;
-                        break;
-                    }
+            c = *s;
 
-                    s += 3; /* skip as it was one byte */
+            if (c != '\\') {
+                /* copy a run of plain chars at once */
+                size_t n = strcspn(s, "\"\\");
 
-                    sscanf(tmp, "%04x", &i);
+                if (n > (size_t)(e - s))
+                    n = e - s;
 
-                    if (i >= 0xd800 && i <= 0xdfff) {
-                        /* it's a surrogate pair */
-                        cp = (i & 0x3ff) << 10;
+                memcpy(p, s, n);
+                p += n;
+                s += n;
 
-                        /* skip to the next value (last char + \ + u)  */
-                        s++;
-                        if (memcmp(s, "\\u", 2) != 0) {
-                            *t = JS_ERROR;
-                            break;
-                        }
-                        s += 2;
+                continue;
+            }
 
-                        strncpy(tmp, s, 4);
-                        tmp[4] = '\0';
+            /* a backslash just before the end */
+            if (s + 1 >= e) {
+                *t = JS_ERROR;
+                break;
+            }
 
-                        if (strlen(tmp) != 4) {
-                            *t = JS_ERROR;
-                            break;
-                        }
+            s++;
+            c = *s++;
+
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u': /* Unicode codepoint as an hex char */
+                if (!_xs_json_hex4(s, &i)) {
+                    *t = JS_ERROR;
+                    break;
+                }
+
+                s += 4;
 
-                        s += 3; /* skip as it was one byte */
+                if (i >= 0xd800 && i <= 0xdfff) {
+                    /* it's a surrogate pair */
+                    cp = (i & 0x3ff) << 10;
 
-                        sscanf(tmp, "%04x", &i);
-                        cp |= (i & 0x3ff);
-                        cp += 0x10000;
+                    if (s + 1 >= e || s[0] != '\\' || s[1] != 'u') {
+                        *t = JS_ERROR;
+                        break;
                     }
-                    else
-                        cp = i;
 
-                    /* replace dangerous control codes with their visual representations */
-                    if (cp >= '\0' && cp < ' ' && !strchr("\r\n\t", cp))
-                        cp += 0x2400;
+                    s += 2;
 
-                    v = xs_utf8_enc(v, cp);
-                    c = '\0';
+                    if (!_xs_json_hex4(s, &i)) {
+                        *t = JS_ERROR;
+                        break;
+                    }
 
-                    break;
+                    s += 4;
+
+                    cp |= (i & 0x3ff);
+                    cp += 0x10000;
                 }
+                else
+                    cp = i;
+
+                /* replace dangerous control codes with their visual representations */
+                if (cp > '\0' && cp < ' ' && !strchr("\r\n\t", cp))
+                    cp += 0x2400;
+
+                /* (a NUL char is dropped) */
+                if (cp)
+                    p = _xs_utf8_enc(p, cp);
+
+                c = '\0';
+
+                break;
             }
 
-            if (c)
-                v = xs_append_m(v, &c, 1);
+            if (*t == JS_ERROR)
+                break;
 
-            s++;
+            if (c)
+                *p++ = c;
         }
 
-        if (c != '\0')
-            s++;
+        *p = '\0';
+
+        if (*t == JS_ERROR)
+            v = xs_free(v);
+        else
+        if (*e == '"')
+            s = e + 1;
+        else {
+            /* unterminated string */
+            s = e;
+            *t = JS_ERROR;
+            v = xs_free(v);
+        }
     }
     else
     if (c == '-' || (c >= '0' && c <= '9') || c == '.') {
-        xs *vn = NULL;
+        const char *b = s - 1;
+        char tmp[64];
+        int n;
 
         *t = JS_INTEGER;
 
-        vn = xs_str_new(NULL);
-        vn = xs_append_m(vn, &c, 1);
-
         while (((c = *s) >= '0' && c <= '9') || c == '.') {
             if (c == '.')
                 *t = JS_REAL;
 
-            vn = xs_append_m(vn, &c, 1);
             s++;
         }
 
         /* convert to XSTYPE_NUMBER */
-        v = xs_number_new(atof(vn));
+        if ((n = s - b) < (int)sizeof(tmp)) {
+            memcpy(tmp, b, n);
+            tmp[n] = '\0';
+
+            v = _xs_json_number(tmp, *t);
+        }
+        else {
+            xs *vn = xs_realloc(NULL, n + 1);
+
+            memcpy(vn, b, n);
+            vn[n] = '\0';
+
+            v = _xs_json_number(vn, *t);
+        }
     }
     else
     if (c == 't' && strncmp(s, "rue", 3) == 0) {
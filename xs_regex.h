@@ -29,12 +29,10 @@ xs_list *xs_regex_split_n(const char *str, const char *rx, int count)
 
     while (count > 0 && !regexec(&re, (p = str + offset), 1, &rm, offset > 0 ? REG_NOTBOL : 0)) {
         /* add first the leading part of the string */
-        list = xs_list_append_m(list, p, rm.rm_so);
-        list = xs_insert_m(list, xs_size(list) - 1, "", 1);
+        list = xs_list_append_strn(list, p, rm.rm_so);
 
         /* add now the matched text as the separator */
-        list = xs_list_append_m(list, p + rm.rm_so, rm.rm_eo - rm.rm_so);
-        list = xs_insert_m(list, xs_size(list) - 1, "", 1);
+        list = xs_list_append_strn(list, p + rm.rm_so, rm.rm_eo - rm.rm_so);
 
         /* move forward */
         offset += rm.rm_eo;
@@ -0,0 +1,125 @@
+/* copyright (c) 2022 - 2023 grunfink / MIT license */
+
+#ifndef _XS_SBUF_H
+
+#define _XS_SBUF_H
+
+typedef struct _xs_sbuf {
+    xs_str *s;              /* the string being built */
+    int len;                /* its length */
+    int size;               /* allocated size */
+} xs_sbuf;
+
+void xs_sbuf_init(xs_sbuf *b);
+void xs_sbuf_cat_m(xs_sbuf *b, const char *mem, int size);
+#define xs_sbuf_cat(b, str) xs_sbuf_cat_m(b, str, strlen(str))
+void xs_sbuf_fmt(xs_sbuf *b, const char *fmt, ...);
+void xs_sbuf_trunc(xs_sbuf *b, int len);
+xs_str *xs_sbuf_result(xs_sbuf *b);
+void xs_sbuf_free(xs_sbuf *b);
+
+
+#ifdef XS_IMPLEMENTATION
+
+/* arbitrary default */
+#define _XS_SBUF_SIZE 4096
+
+static void _xs_sbuf_room(xs_sbuf *b, int size)
+/* ensures there is room for size more bytes and the final zero */
+{
+    if (b->len + size + 1 > b->size) {
+        /* emptied by xs_sbuf_result(): start again */
+        if (b->size == 0)
+            b->size = _XS_SBUF_SIZE;
+
+        /* grow geometrically */
+        while (b->len + size + 1 > b->size)
+            b->size *= 2;
+
+        b->s = xs_realloc(b->s, b->size);
+    }
+}
+
+
+void xs_sbuf_init(xs_sbuf *b)
+/* initializes a string builder */
+{
+    b->size = _XS_SBUF_SIZE;
+    b->len  = 0;
+    b->s    = xs_realloc(NULL, b->size);
+    b->s[0] = '\0';
+}
+
+
+void xs_sbuf_cat_m(xs_sbuf *b, const char *mem, int size)
+/* appends a block of memory */
+{
+    _xs_sbuf_room(b, size);
+
+    memcpy(b->s + b->len, mem, size);
+    b->len += size;
+    b->s[b->len] = '\0';
+}
+
+
+void xs_sbuf_fmt(xs_sbuf *b, const char *fmt, ...)
+/* appends a formatted string, in place */
+{
+    int n;
+    va_list ap;
+
+    /* (there may be no buffer yet) */
+    _xs_sbuf_room(b, 0);
+
+    va_start(ap, fmt);
+    n = vsnprintf(b->s + b->len, b->size - b->len, fmt, ap);
+    va_end(ap);
+
+    if (n >= b->size - b->len) {
+        /* didn't fit: make room and try again */
+        _xs_sbuf_room(b, n);
+
+        va_start(ap, fmt);
+        vsnprintf(b->s + b->len, b->size - b->len, fmt, ap);
+        va_end(ap);
+    }
+
+    if (n > 0)
+        b->len += n;
+}
+
+
+void xs_sbuf_trunc(xs_sbuf *b, int len)
+/* drops everything after len (e.g. a section that ended up empty) */
+{
+    if (len >= 0 && len < b->len) {
+        b->len = len;
+        b->s[b->len] = '\0';
+    }
+}
+
+
+xs_str *xs_sbuf_result(xs_sbuf *b)
+/* returns the built string, leaving the builder empty; it can be
+   used again, allocating a new buffer on the next append */
+{
+    xs_str *s = b->s;
+
+    b->s    = NULL;
+    b->len  = 0;
+    b->size = 0;
+
+    return s;
+}
+
+
+void xs_sbuf_free(xs_sbuf *b)
+/* frees a string builder, dropping its content */
+{
+    xs_free(xs_sbuf_result(b));
+}
+
+
+#endif /* XS_IMPLEMENTATION */
+
+#endif /* _XS_SBUF_H */
@@ -15,6 +15,7 @@ void xs_set_init(xs_set *s);
 xs_list *xs_set_result(xs_set *s);
 void xs_set_free(xs_set *s);
 int xs_set_add(xs_set *s, const xs_val *data);
+int xs_set_in(const xs_set *s, const xs_val *data);
 
 
 #ifdef XS_IMPLEMENTATION
@@ -47,7 +48,7 @@ xs_list *xs_set_result(xs_set *s)
 void xs_set_free(xs_set *s)
 /* frees a set, dropping the list */
 {
-    free(xs_set_result(s));
+    xs_free(xs_set_result(s));
 }
 
 
@@ -100,7 +101,8 @@ int xs_set_add(xs_set *s, const xs_val *data)
             _store_hash(s, v, v - s->list);
     }
 
-    int ret = _store_hash(s, data, xs_size(s->list));
+    /* the data will be stored just after the new item header */
+    int ret = _store_hash(s, data, xs_size(s->list) - 1 + _XS_ITEM_HDR);
 
     /* if it's new, add the data */
     if (ret)
@@ -109,6 +111,25 @@ int xs_set_add(xs_set *s, const xs_val *data)
     return ret;
 }
 
+
+int xs_set_in(const xs_set *s, const xs_val *data)
+/* returns 1 if the data is in the set */
+{
+    unsigned int hash, i;
+    int sz = xs_size(data);
+
+    hash = xs_hash_func(data, sz);
+
+    while (s->hash[(i = hash % s->elems)]) {
+        if (memcmp(&s->list[s->hash[i]], data, sz) == 0)
+            return 1;
+
+        hash++;
+    }
+
+    return 0;
+}
+
 #endif /* XS_IMPLEMENTATION */
 
 #endif /* XS_SET_H */
\ No newline at end of file